@@ -1,113 +1,1162 @@
 #ifndef INCLUDE_YAECL_HPP_
 #define INCLUDE_YAECL_HPP_
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <bitset>
 #include <fstream>
+#include <functional>
 #include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
-#include <pybind11/pybind11.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define YAECL_X86_DISPATCH
+#include <immintrin.h>
+#endif
+#ifdef YAECL_ENABLE_STATS
+/* statement only compiled with YAECL_ENABLE_STATS, for the counters of CodecStats */
+#define YAECL_STAT(...) do{ __VA_ARGS__; }while(0)
+#else
+#define YAECL_STAT(...) do{}while(0)
+#endif
 
 namespace yaecl {
 
 class BitStream {
+  /* bits are appended through the 64 bit register _acc and moved to _data a whole
+   * word at a time, bits are read through the 64 bit register _racc refilled up to
+   * 8 bytes at a time. when _acc_bits > 0, _data holds the first (_pos - _acc_bits) / 8
+   * bytes and the rest are in _acc. byte layout is msb first, same as bit by bit push.
+   * a stream made by view() reads _view instead of _data without copying it, and copies
+   * it to _data on the first push.
+   * with a sink or a source _data only holds bytes from _base on: bytes before _base
+   * were drained to the sink or already read from the source.
+   */
   public:
-    BitStream(){ _pos = 0; _fpos=0; }
+    BitStream(){ _pos = 0; _fpos=0; _acc = 0; _acc_bits = 0; _racc = 0; _racc_bits = 0; _view = nullptr; _view_len = 0; _base = 0; _capacity = 0; _marks = 0; }
+    BitStream(const uint8_t *data, const size_t &len){
+        /* stream holding a copy of len bytes */
+        _data.assign(data, data + len);
+        _pos = static_cast<int64_t>(len) * 8;
+        _fpos = 0;
+        _acc = 0;
+        _acc_bits = 0;
+        _racc = 0;
+        _racc_bits = 0;
+        _view = nullptr;
+        _view_len = 0;
+        _base = 0;
+        _capacity = 0;
+        _marks = 0;
+    }
+    static BitStream view(const uint8_t *data, const size_t &len, const std::shared_ptr<const void> &owner = nullptr){
+        /* read only stream over len bytes of external memory, no copy
+         * owner:
+         * * kept alive as long as the stream (or a copy of it) reads data, e.g. the python buffer
+         * * with nullptr, data must outlive the stream
+         */
+        BitStream bit_stream;
+        bit_stream._view = data;
+        bit_stream._view_len = len;
+        bit_stream._owner = owner;
+        bit_stream._pos = static_cast<int64_t>(len) * 8;
+        return bit_stream;
+    }
     ~BitStream(){}
+    BitStream(const BitStream &) = default;
+    BitStream &operator=(const BitStream &) = default;
+    BitStream(BitStream &&bit_stream) noexcept : BitStream() { swap(bit_stream); }
+    BitStream &operator=(BitStream &&bit_stream) noexcept {
+        /* takes the bytes of bit_stream without a copy, bit_stream is left empty
+         * holding the old buffer of this stream, so its capacity is not lost
+         */
+        swap(bit_stream);
+        bit_stream.clear();
+        return *this;
+    }
+    void swap(BitStream &bit_stream) noexcept {
+        std::swap(_data, bit_stream._data);
+        std::swap(_view, bit_stream._view);
+        std::swap(_view_len, bit_stream._view_len);
+        std::swap(_owner, bit_stream._owner);
+        std::swap(_sink, bit_stream._sink);
+        std::swap(_source, bit_stream._source);
+        std::swap(_base, bit_stream._base);
+        std::swap(_capacity, bit_stream._capacity);
+        std::swap(_pos, bit_stream._pos);
+        std::swap(_fpos, bit_stream._fpos);
+        std::swap(_acc, bit_stream._acc);
+        std::swap(_acc_bits, bit_stream._acc_bits);
+        std::swap(_racc, bit_stream._racc);
+        std::swap(_racc_bits, bit_stream._racc_bits);
+        std::swap(_undo, bit_stream._undo);
+        std::swap(_marks, bit_stream._marks);
+    }
+    void reserve(const size_t &bytes){
+        /* allocate bytes up front, e.g. the expected coded size, so that pushes do not reallocate */
+        _data.reserve(bytes);
+    }
+    size_t capacity() const { return _data.capacity(); }
+    const std::shared_ptr<const void> &owner() const {
+        /* owner of the memory of a view, nullptr when the stream owns its bytes */
+        return _owner;
+    }
+    void clear(){
+        /* back to an empty stream keeping the capacity of the buffer, for coding the next
+         * stream without allocating. a view, sink, source and marks are dropped
+         */
+        _data.clear();
+        _view = nullptr;
+        _view_len = 0;
+        _owner.reset();
+        _sink = nullptr;
+        _source = nullptr;
+        _base = 0;
+        _capacity = 0;
+        _pos = 0;
+        _fpos = 0;
+        _acc = 0;
+        _acc_bits = 0;
+        _racc = 0;
+        _racc_bits = 0;
+        _undo.clear();
+        _marks = 0;
+    }
+    void set_sink(const std::function<void(const uint8_t*, size_t)> &sink, const size_t &capacity = 1 << 16){
+        /* fifo writing with bounded memory, use with ac / range coding encoder
+         * sink:
+         * * called with each block of bytes once capacity bytes are buffered, and by drain
+         * capacity:
+         * * bytes buffered before calling sink, the memory used stays at this size
+         * get, pop_back, data and save only see bytes not drained yet
+         */
+        assert(capacity >= 16 && !_view && !_source);
+        _sink = sink;
+        _capacity = capacity;
+        _data.reserve(capacity + 8);
+    }
+    void set_source(const std::function<size_t(uint8_t*, size_t)> &source, const size_t &capacity = 1 << 16){
+        /* fifo reading with bounded memory, use with ac / range coding decoder
+         * source:
+         * * source(buf, len) writes up to len bytes to buf and returns the count, 0 at end of stream
+         * capacity:
+         * * bytes buffered from source, the memory used stays at this size
+         */
+        assert(capacity >= 16 && _pos == 0 && !_sink);
+        _source = source;
+        _capacity = capacity;
+        _data.reserve(capacity);
+    }
+    void drain(){
+        /* send all buffered bytes to the sink, last byte zero padded
+         * call once at the end of encoding, flush of the encoders does it
+         */
+        if(!_sink) return;
+        _commit();
+        _drain();
+    }
+    static std::function<void(const uint8_t*, size_t)> ostream_sink(std::ostream &os){
+        /* sink writing to os, os must outlive the stream */
+        return [&os](const uint8_t *data, size_t len){ os.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(len)); };
+    }
+    static std::function<size_t(uint8_t*, size_t)> istream_source(std::istream &is){
+        /* source reading from is, is must outlive the stream */
+        return [&is](uint8_t *data, size_t len){
+            is.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(len));
+            return static_cast<size_t>(is.gcount());
+        };
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    static std::function<void(const uint8_t*, size_t)> fd_sink(const int &fd){
+        /* sink writing to file descriptor fd, e.g. a pipe or a socket */
+        return [fd](const uint8_t *data, size_t len){
+            while(len){
+                ssize_t n = ::write(fd, data, len);
+                assert(n > 0);
+                if(n <= 0) return;
+                data += n;
+                len -= n;
+            }
+        };
+    }
+    static std::function<size_t(uint8_t*, size_t)> fd_source(const int &fd){
+        /* source reading from file descriptor fd */
+        return [fd](uint8_t *data, size_t len){
+            ssize_t n = ::read(fd, data, len);
+            return static_cast<size_t>(n > 0 ? n : 0);
+        };
+    }
+#endif
     void push_back(bool bit){
-        if(_pos % 8==0) _data.push_back(0);
-        _data[_pos / 8] |= (bit << (7 - (_pos % 8)));
-        _pos++;
+        push_bits(bit, 1);
+    }
+    void push_bits(const uint64_t &bits, const int &n){
+        /* msb first push of the low n bits of bits, 0 <= n <= 56
+         */
+        assert(n >= 0 && n <= 56);
+        if(_view) _own();
+        if(_acc_bits == 0 && (_base + static_cast<int64_t>(_data.size())) * 8 != _pos) _reload();
+        if(_acc_bits + n > 64) _spill();
+        _acc = (_acc << n) | (bits & ((static_cast<uint64_t>(1) << n) - 1));
+        _acc_bits += n;
+        _pos += n;
+    }
+    void push_bit_run(bool bit, uint64_t count){
+        /* push count copies of bit, used for pending bits of ac
+         */
+        uint64_t word = bit ? ~static_cast<uint64_t>(0) : 0;
+        for(; count > 56; count -= 56)
+            push_bits(word, 56);
+        push_bits(word, static_cast<int>(count));
     }
     void push_back_byte(uint8_t byte){
         /* alined push for fast ANS
          */
         assert(_pos % 8 == 0);
-        _data.push_back(byte);
+        if(_view) _own();
+        if(_acc_bits){
+            push_bits(byte, 8);
+            return;
+        }
+        assert(_pos / 8 >= _base);
+        size_t i = _pos / 8 - _base;
+        if(i < _data.size()){
+            if(_marks) _undo.emplace_back(_pos / 8, _data[i]);
+            _data[i] = byte;
+        }else{
+            _data.push_back(byte);
+            if(_sink && _data.size() >= _capacity) _drain();
+        }
         _pos+=8;
     }
-    bool get(int pos){
-        assert(pos < _pos);
-        return _data[pos / 8] & (1 << (7 - (pos % 8)));
+    void push_back_bytes(const uint8_t *data, const size_t &len){
+        /* aligned push of len bytes
+         */
+        assert(_pos % 8 == 0 && !_marks);
+        if(_view) _own();
+        _commit();
+        assert(_pos / 8 >= _base);
+        _data.resize(_pos / 8 - _base);
+        _data.insert(_data.end(), data, data + len);
+        _pos += static_cast<int64_t>(len) * 8;
+        if(_sink && _data.size() >= _capacity) _drain();
+    }
+    bool get(int64_t pos){
+        assert(pos < _pos && pos / 8 >= _base);
+        _commit();
+        return _bytes()[pos / 8 - _base] & (1 << (7 - (pos % 8)));
     }
     bool pop_front(){
         /* queue style pop, use only with ac
          */
-        if (_fpos >= _pos) return 0;
-        bool tmp = get(_fpos);
+        if (_fpos >= _pos && !(_source && _pull())) return 0;
+        if (_racc_bits == 0) _refill();
+        bool tmp = static_cast<bool>(_racc >> 63);
+        _racc <<= 1;
+        _racc_bits--;
         _fpos++;
         return tmp;
     }
+    uint64_t pop_front_bits(const int &n){
+        /* queue style pop of n bits, msb first, 0 <= n <= 56
+         * bits after the end of stream read as 0
+         */
+        assert(n >= 0 && n <= 56);
+        if (_source && _pos - _fpos < n) _pull();
+        int valid = static_cast<int>(std::min<int64_t>(n, _pos - _fpos));
+        if (valid <= 0) return 0;
+        if (_racc_bits < valid) _refill();
+        uint64_t bits = _racc >> (64 - valid);
+        _racc <<= valid;
+        _racc_bits -= valid;
+        _fpos += valid;
+        return bits << (n - valid);
+    }
+    int64_t front(){
+        /* bit position of the next pop_front */
+        return _fpos;
+    }
+    void seek_front(const int64_t &pos){
+        /* move the pop_front position to pos, for decoders that read data() directly, not with a source */
+        assert(!_source && pos >= 0 && pos <= _pos);
+        _commit();
+        _fpos = pos;
+        _racc_bits = static_cast<int>((8 - pos % 8) % 8);
+        _racc = _racc_bits ? static_cast<uint64_t>(_bytes()[pos / 8 - _base]) << (56 + pos % 8) : 0;
+    }
+    uint8_t pop_front_byte(){
+        /* queue style pop of 8 bits, use only with range coding
+         */
+        return static_cast<uint8_t>(pop_front_bits(8));
+    }
     bool pop_back(){
         /* queue style pop, use only with ans
          */
         if (_pos <= 0) return 0;
+        _commit();
         _pos--;
-        return _data[_pos / 8] & (1 << (7 - (_pos % 8)));
+        assert(_pos / 8 >= _base);
+        return _bytes()[_pos / 8 - _base] & (1 << (7 - (_pos % 8)));
     }
     uint8_t pop_back_byte(){
-        /* alined pop for fast ANS
+        /* alined pop for fast ANS, reads 0 before the start of stream as pop_back,
+         * so a truncated or corrupt stream can not read out of bounds
          */
         assert(_pos % 8 == 0);
+        if(_pos <= 0) return 0;
+        _commit();
         _pos-=8;
-        return _data[_pos / 8];
+        assert(_pos / 8 >= _base);
+        return _bytes()[_pos / 8 - _base];
+    }
+    size_t mark(){
+        /* start logging the bytes that push_back_byte overwrites (left behind by pop_back_byte),
+         * so that rewind can go back to this point without copying the stream. marks nest and
+         * each one needs an unmark, until then the stream may only be written by push_back_byte
+         * return:
+         * * position in the undo log, for rewind
+         */
+        assert(_pos % 8 == 0);
+        _marks++;
+        return _undo.size();
+    }
+    void rewind(const int64_t &pos, const size_t &undo){
+        /* restore the bytes overwritten since the mark that returned undo and set the size to pos */
+        assert(_marks > 0 && undo <= _undo.size() && pos % 8 == 0);
+        _commit();
+        for(size_t k = _undo.size(); k-- > undo;)
+            _data[_undo[k].first - _base] = _undo[k].second;
+        _undo.resize(undo);
+        assert(pos / 8 >= _base && static_cast<size_t>(pos / 8 - _base) <= _bytes_size());
+        _pos = pos;
+    }
+    void unmark(){
+        /* end the last mark, the undo log is dropped with the outermost one */
+        assert(_marks > 0);
+        if(--_marks == 0) _undo.clear();
+    }
+    int64_t size(){ return _pos; }
+    int64_t byte_size(){ return _pos / 8 + int(_pos % 8 != 0); }
+    const uint8_t *data(){
+        /* the byte_size() bytes of the stream, last byte zero padded */
+        _commit();
+        return _bytes();
+    }
+    bool is_view() const { return _view != nullptr; }
+    bool share(){
+        /* turn an owned stream into a view of its bytes in a buffer held by owner(), without a copy,
+         * so the bytes can be handed out (e.g. the python buffer protocol) and stay valid as long as
+         * the owner is held: the next write copies them back, as for any view
+         * return:
+         * * true if owner() holds the bytes of the stream, false for an empty stream, a view without
+         *   owner, or a stream with a sink, a source or marks, which keep writing their buffer in place
+         */
+        if(_view) return _owner != nullptr;
+        if(_sink || _source || _marks || _pos == 0) return false;
+        _commit();
+        std::shared_ptr<std::vector<uint8_t> > bytes = std::make_shared<std::vector<uint8_t> >(std::move(_data));
+        _data.clear();
+        _view = bytes->data();
+        _view_len = bytes->size();
+        _owner = bytes;
+        return _view != nullptr;
     }
-    int size(){ return _pos; }
     void save(const std::string &fpath){
         std::ofstream of(fpath, std::ios::out | std::ios::binary);
-        of.write(reinterpret_cast<const char*>(_data.data()), _pos / 8 + int(_pos % 8 != 0));
+        write(of);
+    }
+    void write(std::ostream &os){
+        /* write all bytes of the stream in one call, last byte zero padded */
+        _commit();
+        os.write(reinterpret_cast<const char*>(_bytes()), static_cast<std::streamsize>(byte_size()));
     }
     void load(const std::string &fpath){
+        /* append the whole file with one read, the stream must be byte aligned
+         * throws std::runtime_error if the file can not be opened or read
+         */
+        if(_view) _own();
+        assert(_pos % 8 == 0);
+        _commit();
         std::ifstream rf(fpath, std::ios::in | std::ios::binary);
+        if(!rf.good())
+            throw std::runtime_error("BitStream: can not open " + fpath);
         rf.seekg(0, rf.end);
-        int flen = rf.tellg();
+        std::streamoff flen = rf.tellg();
         rf.seekg(0, rf.beg);
-        while(flen){
-            uint8_t tmp;
-            rf.read(reinterpret_cast<char*>(&tmp), 1);
-            _data.push_back(tmp);
-            _pos+=8;
-            flen--;
+        if(flen < 0)
+            throw std::runtime_error("BitStream: can not read " + fpath);
+        if(flen == 0) return;
+        size_t offset = static_cast<size_t>(_pos / 8);
+        _data.resize(offset + flen);
+        if(!rf.read(reinterpret_cast<char*>(_data.data() + offset), flen)){
+            _data.resize(offset);
+            throw std::runtime_error("BitStream: can not read " + fpath);
         }
+        _pos += static_cast<int64_t>(flen) * 8;
     }
-    pybind11::bytes getData() {
-        return pybind11::bytes(reinterpret_cast<const char*>(_data.data()), _pos / 8 + int(_pos % 8 != 0));
-    }
-    void setData(const pybind11::bytes &data) {
-        std::string s = data;
-        _data = std::vector<uint8_t>(s.begin(), s.end());
-        _pos = _data.size() * 8;
-        _fpos = 0;
+    static BitStream map(const std::string &fpath){
+        /* read only stream over the memory mapped file, the os pages it in as the decoder
+         * reads, so multi GB streams decode without a copy in memory
+         * falls back to load where mmap is not available
+         * throws std::runtime_error if the file can not be opened or mapped, an empty file
+         * gives an empty stream
+         */
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(fpath.c_str(), O_RDONLY);
+        if(fd < 0)
+            throw std::runtime_error("BitStream: can not open " + fpath);
+        struct stat st;
+        if(::fstat(fd, &st) != 0){
+            ::close(fd);
+            throw std::runtime_error("BitStream: can not stat " + fpath);
+        }
+        if(st.st_size == 0){
+            ::close(fd);
+            return BitStream();
+        }
+        size_t len = static_cast<size_t>(st.st_size);
+        void *addr = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(addr == MAP_FAILED)
+            throw std::runtime_error("BitStream: can not map " + fpath);
+        std::shared_ptr<const void> owner(addr, [len](const void *p){ ::munmap(const_cast<void*>(p), len); });
+        return view(static_cast<const uint8_t*>(addr), len, owner);
+#else
+        BitStream bit_stream;
+        bit_stream.load(fpath);
+        return bit_stream;
+#endif
     }
   private:
+    const uint8_t *_bytes() const { return _view ? _view : _data.data(); }
+    size_t _bytes_size() const { return _view ? _view_len : _data.size(); }
+    void _own(){
+        /* copy the viewed bytes to _data before the first write */
+        _data.assign(_view, _view + _view_len);
+        _view = nullptr;
+        _owner.reset();
+    }
+    void _spill(){
+        /* move whole bytes of _acc to _data */
+        size_t n = _acc_bits / 8;
+        size_t offset = _data.size();
+        _data.resize(offset + n);
+        for(size_t i = 0; i < n; i++){
+            _acc_bits -= 8;
+            _data[offset + i] = static_cast<uint8_t>(_acc >> _acc_bits);
+        }
+        if(_sink && _data.size() >= _capacity) _drain();
+    }
+    void _drain(){
+        _sink(_data.data(), _data.size());
+        _base += _data.size();
+        _data.clear();
+    }
+    bool _pull(){
+        /* drop the bytes already in _racc, then fill _data from the source */
+        size_t used = static_cast<size_t>((_fpos + _racc_bits) / 8 - _base);
+        _data.erase(_data.begin(), _data.begin() + used);
+        _base += used;
+        size_t offset = _data.size();
+        _data.resize(std::max(_capacity, offset + 8));
+        size_t got = _source(_data.data() + offset, _data.size() - offset);
+        _data.resize(offset + got);
+        _pos = (_base + static_cast<int64_t>(_data.size())) * 8;
+        return got > 0;
+    }
+    void _commit(){
+        /* move all bits of _acc to _data, last byte zero padded */
+        if(_acc_bits == 0) return;
+        _spill();
+        if(_acc_bits){
+            _data.push_back(static_cast<uint8_t>(_acc << (8 - _acc_bits)));
+            _acc_bits = 0;
+        }
+    }
+    void _reload(){
+        /* drop bytes after _pos (left by pop_back) and take the partial last byte back to _acc */
+        assert(!_marks);
+        _data.resize((_pos + 7) / 8 - _base);
+        int r = _pos % 8;
+        if(r){
+            _acc = _data.back() >> (8 - r);
+            _acc_bits = r;
+            _data.pop_back();
+        }
+    }
+    void _refill(){
+        /* top up _racc with whole bytes, starting from the first byte not read yet */
+        _commit();
+        const uint8_t *bytes = _bytes();
+        size_t len = _bytes_size();
+        size_t i = static_cast<size_t>((_fpos + _racc_bits) / 8 - _base);
+        if(_racc_bits == 0 && i + 8 <= len){
+            const uint8_t *p = bytes + i;
+            _racc = (static_cast<uint64_t>(p[0]) << 56) | (static_cast<uint64_t>(p[1]) << 48) |
+                    (static_cast<uint64_t>(p[2]) << 40) | (static_cast<uint64_t>(p[3]) << 32) |
+                    (static_cast<uint64_t>(p[4]) << 24) | (static_cast<uint64_t>(p[5]) << 16) |
+                    (static_cast<uint64_t>(p[6]) << 8) | static_cast<uint64_t>(p[7]);
+            _racc_bits = 64;
+            return;
+        }
+        for(; _racc_bits <= 56 && i < len; i++){
+            _racc |= static_cast<uint64_t>(bytes[i]) << (56 - _racc_bits);
+            _racc_bits += 8;
+        }
+    }
     std::vector<uint8_t> _data;
-    int _pos;
-    int _fpos;
+    const uint8_t *_view;
+    size_t _view_len;
+    std::shared_ptr<const void> _owner;
+    std::function<void(const uint8_t*, size_t)> _sink;
+    std::function<size_t(uint8_t*, size_t)> _source;
+    int64_t _base;
+    size_t _capacity;
+    int64_t _pos;
+    int64_t _fpos;
+    uint64_t _acc;
+    int _acc_bits;
+    uint64_t _racc;
+    int _racc_bits;
+    std::vector<std::pair<int64_t, uint8_t> > _undo;
+    int _marks;
 };
-template <typename T_in, typename T_out>
+class BitStreamPool {
+  /* free list of stream buffers: release keeps the buffer of a finished stream and
+   * acquire hands it out again, so coding many streams (e.g. one per image in a server)
+   * stops allocating once the pool is warm. thread safe, one pool serves all threads
+   */
+  public:
+    BitStreamPool(const size_t &reserve = 1 << 16, const size_t &max_free = 64){
+        /* reserve:
+         * * capacity in bytes of the streams made while the pool is empty
+         * max_free:
+         * * number of buffers kept, buffers released beyond it are freed
+         */
+        _reserve = reserve;
+        _max_free = max_free;
+    }
+    ~BitStreamPool(){}
+    BitStream acquire(){
+        /* an empty stream, with the largest buffer released so far when there is one */
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(_free.empty()){
+            lock.unlock();
+            BitStream bit_stream;
+            bit_stream.reserve(_reserve);
+            return bit_stream;
+        }
+        BitStream bit_stream(std::move(_free.back()));
+        _free.pop_back();
+        return bit_stream;
+    }
+    void release(BitStream &bit_stream){
+        /* take back the buffer of bit_stream, which is left empty without capacity */
+        BitStream kept(std::move(bit_stream));
+        kept.clear();
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.size() >= _max_free) return;
+        _free.push_back(std::move(kept));
+        for(size_t k = _free.size() - 1; k > 0 && _free[k - 1].capacity() > _free[k].capacity(); k--)
+            _free[k - 1].swap(_free[k]);
+    }
+    size_t free_count(){
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _free.size();
+    }
+  private:
+    size_t _reserve;
+    size_t _max_free;
+    std::vector<BitStream> _free;
+    std::mutex _mutex;
+};
+struct CodecStats {
+  /* counters of the coding hot paths, see stats() of each codec. they are only kept
+   * when YAECL_ENABLE_STATS is defined, otherwise the codecs hold no counters, every
+   * update compiles to nothing and stats() returns none()
+   */
+    int64_t symbols = 0;
+    /* sum of -log2(p) of the coded symbols, the size an ideal coder would reach */
+    double ideal_bits = 0;
+    /* renormalization steps: bits shifted out / in by ArithmeticCoding, bytes by RangeCoding,
+     * byte spills / refills of the rans states, states that read / write bits in TANS
+     */
+    int64_t renorm = 0;
+    /* underflow bits of ArithmeticCoding and 0xff bytes held back by RangeCoding, waiting on a later bit / carry */
+    int64_t pending = 0;
+    int64_t max_pending = 0;
+    /* carries propagated into held back bytes by RangeCodingEncoder */
+    int64_t carries = 0;
+    static bool enabled(){
+#ifdef YAECL_ENABLE_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+    static const CodecStats &none(){
+        /* all counters 0, the stats() of every codec without YAECL_ENABLE_STATS */
+        static const CodecStats stats = CodecStats();
+        return stats;
+    }
+    void add(const int64_t &freq, const int &cdf_bits){
+        /* one symbol of probability freq / 2 ** cdf_bits */
+        symbols++;
+        ideal_bits += cdf_bits - std::log2(static_cast<double>(freq));
+    }
+    void merge(const CodecStats &other){
+        /* add the counters of other, e.g. of the chunks of a ChunkedCodec */
+        symbols += other.symbols;
+        ideal_bits += other.ideal_bits;
+        renorm += other.renorm;
+        pending += other.pending;
+        max_pending = std::max(max_pending, other.max_pending);
+        carries += other.carries;
+    }
+    double overhead(const int64_t &bits) const {
+        /* bits over the ideal size, bits is the size of the coded stream */
+        return static_cast<double>(bits) - ideal_bits;
+    }
+    void reset(){
+        *this = CodecStats();
+    }
+};
+enum class SimdLevel : uint8_t {
+    SCALAR = 0,
+    AVX2 = 1,
+    AVX512 = 2
+};
+inline SimdLevel detect_simd_level(){
+    /* best kernels the cpu runs, checked at run time so one binary serves every x86 machine */
+#ifdef YAECL_X86_DISPATCH
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+    if(__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+#endif
+    return SimdLevel::SCALAR;
+}
+inline std::atomic<int> &_simd_level(){
+    static std::atomic<int> level(static_cast<int>(detect_simd_level()));
+    return level;
+}
+inline SimdLevel simd_level(){
+    /* kernels used by cdf_search and rans_lane_update, detect_simd_level unless set_simd_level was called */
+    return static_cast<SimdLevel>(_simd_level().load(std::memory_order_relaxed));
+}
+inline SimdLevel set_simd_level(const SimdLevel &level){
+    /* use level or the best below it the cpu runs, e.g. SCALAR to compare against the simd kernels.
+     * returns the level set, the stream format does not depend on it
+     */
+    SimdLevel set = std::min(level, detect_simd_level());
+    _simd_level().store(static_cast<int>(set), std::memory_order_relaxed);
+    return set;
+}
+#ifdef YAECL_X86_DISPATCH
+__attribute__((target("avx2,popcnt")))
+inline int _cdf_count_avx2(const int &n, const uint32_t *cdf, const uint32_t &value){
+    /* number of cdf[0, n) <= value, entries and value < 2 ** 31 */
+    const __m256i v = _mm256_set1_epi32(static_cast<int>(value));
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int count = 0;
+    for(int k = 0; k < n; k += 8){
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - k), lane);
+        __m256i c = _mm256_maskload_epi32(reinterpret_cast<const int*>(cdf + k), mask);
+        __m256i le = _mm256_andnot_si256(_mm256_cmpgt_epi32(c, v), mask);
+        count += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(le))));
+    }
+    return count;
+}
+__attribute__((target("avx512f,popcnt")))
+inline int _cdf_count_avx512(const int &n, const uint32_t *cdf, const uint32_t &value){
+    /* See _cdf_count_avx2 */
+    const __m512i v = _mm512_set1_epi32(static_cast<int>(value));
+    int count = 0;
+    for(int k = 0; k < n; k += 16){
+        __mmask16 mask = n - k >= 16 ? static_cast<__mmask16>(0xffff) : static_cast<__mmask16>((1u << (n - k)) - 1);
+        __m512i c = _mm512_maskz_loadu_epi32(mask, cdf + k);
+        count += __builtin_popcount(static_cast<unsigned>(_mm512_mask_cmple_epu32_mask(mask, c, v)));
+    }
+    return count;
+}
+__attribute__((target("avx2")))
+inline void _rans_lane_update_avx2(uint64_t *state, const uint64_t *c_range, const uint64_t *bias, const int &n, const int &cdf_bits){
+    /* See rans_lane_update, 4 lanes per step, c_range < 2 ** 32 so the 64 bit product is two 32 x 32 multiplies */
+    const __m128i shift = _mm_cvtsi32_si128(cdf_bits);
+    int l = 0;
+    for(; l + 4 <= n; l += 4){
+        __m256i x = _mm256_srl_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + l)), shift);
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c_range + l));
+        __m256i lo = _mm256_mul_epu32(x, c);
+        __m256i hi = _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), c), 32);
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bias + l));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + l), _mm256_add_epi64(_mm256_add_epi64(lo, hi), b));
+    }
+    for(; l < n; l++)
+        state[l] = c_range[l] * (state[l] >> cdf_bits) + bias[l];
+}
+__attribute__((target("avx512f")))
+inline void _rans_lane_update_avx512(uint64_t *state, const uint64_t *c_range, const uint64_t *bias, const int &n, const int &cdf_bits){
+    /* See _rans_lane_update_avx2, 8 lanes per step. the maskz forms with every lane set are the
+     * plain instructions, the unmasked intrinsics of gcc merge into an undefined register and warn
+     */
+    const __m128i shift = _mm_cvtsi32_si128(cdf_bits);
+    const __mmask8 all = 0xff;
+    int l = 0;
+    for(; l + 8 <= n; l += 8){
+        __m512i x = _mm512_maskz_srl_epi64(all, _mm512_loadu_si512(state + l), shift);
+        __m512i c = _mm512_loadu_si512(c_range + l);
+        __m512i lo = _mm512_maskz_mul_epu32(all, x, c);
+        __m512i hi = _mm512_maskz_slli_epi64(all, _mm512_maskz_mul_epu32(all, _mm512_maskz_srli_epi64(all, x, 32), c), 32);
+        __m512i b = _mm512_loadu_si512(bias + l);
+        _mm512_storeu_si512(state + l, _mm512_add_epi64(_mm512_add_epi64(lo, hi), b));
+    }
+    _rans_lane_update_avx2(state + l, c_range + l, bias + l, n - l, cdf_bits);
+}
+#endif
+template <typename T_out, typename T_in>
+inline T_out cdf_search(const int &sym_cnt, const T_out *cdf, const T_in &scaled_value){
+    /* sym with cdf[sym] <= scaled_value < cdf[sym + 1], args: See ArithmeticCodingDecoder
+     * 32 bit cdfs of up to 64 symbols are compared with scaled_value in simd registers and
+     * the entries <= scaled_value counted, without a data dependent branch. otherwise binary search
+     */
+#ifdef YAECL_X86_DISPATCH
+    if(sizeof(T_out) == 4 && sym_cnt <= 64){
+        const uint32_t *c = reinterpret_cast<const uint32_t*>(cdf) + 1;
+        switch(simd_level()){
+            case SimdLevel::AVX512: return static_cast<T_out>(_cdf_count_avx512(sym_cnt - 1, c, static_cast<uint32_t>(scaled_value)));
+            case SimdLevel::AVX2: return static_cast<T_out>(_cdf_count_avx2(sym_cnt - 1, c, static_cast<uint32_t>(scaled_value)));
+            case SimdLevel::SCALAR: break;
+        }
+    }
+#endif
+    T_in start = 0;
+    T_in end = sym_cnt;
+    while (end - start > 1) {
+        T_in middle = (start + end) >> 1;
+        if (static_cast<T_in>(cdf[middle]) > scaled_value)
+            end = middle;
+        else
+            start = middle;
+    }
+    assert(start + 1 == end);
+    return static_cast<T_out>(start);
+}
+template <typename T_in>
+inline void rans_lane_update(T_in *state, const T_in *c_range, const T_in *bias, const int &n, const int &cdf_bits){
+    /* rans decode step of n lanes: state = c_range * (state >> cdf_bits) + bias, bias = scaled_value - c_low */
+    for(int l = 0; l < n; l++)
+        state[l] = c_range[l] * (state[l] >> cdf_bits) + bias[l];
+}
+inline void rans_lane_update(uint64_t *state, const uint64_t *c_range, const uint64_t *bias, const int &n, const int &cdf_bits){
+    /* See rans_lane_update, with the 64 bit states of the python codecs on the simd kernels */
+#ifdef YAECL_X86_DISPATCH
+    switch(simd_level()){
+        case SimdLevel::AVX512: _rans_lane_update_avx512(state, c_range, bias, n, cdf_bits); return;
+        case SimdLevel::AVX2: _rans_lane_update_avx2(state, c_range, bias, n, cdf_bits); return;
+        case SimdLevel::SCALAR: break;
+    }
+#endif
+    for(int l = 0; l < n; l++)
+        state[l] = c_range[l] * (state[l] >> cdf_bits) + bias[l];
+}
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class CDFTable {
+  /* a cdf prepared for decoding. _lut maps the top lut_bits bits of a scaled value
+   * to the first symbol it may belong to, so decode is one lookup plus a search
+   * inside one bucket instead of a binary search over the whole cdf. with
+   * cdf_bits <= lut_bits the lookup is exact.
+   */
+  public:
+    CDFTable(const int &sym_cnt, const T_out *cdf, const int &cdf_bits, const int &lut_bits = 12){
+        /* sym_cnt, cdf, cdf_bits:
+         * * See ArithmeticCodingDecoder, the cdf is copied
+         * lut_bits:
+         * * log2 of the number of lookup buckets, the table has min(cdf_bits, lut_bits) bits
+         * * default: 12
+         */
+        assert(sym_cnt >= 1 && lut_bits >= 0);
+        _sym_cnt = sym_cnt;
+        _cdf_bits = cdf_bits;
+        _cdf.assign(cdf, cdf + sym_cnt + 1);
+        _shift = std::max(0, cdf_bits - lut_bits);
+        size_t buckets = static_cast<size_t>(1) << (cdf_bits - _shift);
+        _lut.resize(buckets + 1);
+        int sym = 0;
+        for(size_t b = 0; b < buckets; b++){
+            uint64_t value = static_cast<uint64_t>(b) << _shift;
+            while(sym + 1 < sym_cnt && static_cast<uint64_t>(_cdf[sym + 1]) <= value) sym++;
+            _lut[b] = static_cast<T_out>(sym);
+        }
+        _lut[buckets] = static_cast<T_out>(sym_cnt - 1);
+    }
+    ~CDFTable(){}
+    template <typename T_in>
+    T_out find(const T_in &scaled_value) const {
+        /* scaled_value:
+         * * value in [0, 2 ** cdf_bits), returns sym with cdf[sym] <= scaled_value < cdf[sym + 1]
+         */
+        size_t b = static_cast<size_t>(scaled_value >> _shift);
+        if(_shift == 0) return _lut[b];
+        T_in start = _lut[b];
+        T_in end = static_cast<T_in>(_lut[b + 1]) + 1;
+        while (end - start > 1) {
+            T_in middle = (start + end) >> 1;
+            if (static_cast<T_in>(_cdf[middle]) > scaled_value)
+                end = middle;
+            else
+                start = middle;
+        }
+        return static_cast<T_out>(start);
+    }
+    bool matches(const int &sym_cnt, const T_out *cdf, const int &cdf_bits) const {
+        return sym_cnt == _sym_cnt && cdf_bits == _cdf_bits && std::equal(_cdf.begin(), _cdf.end(), cdf);
+    }
+    const T_out *cdf() const { return _cdf.data(); }
+    int sym_cnt() const { return _sym_cnt; }
+    int cdf_bits() const { return _cdf_bits; }
+  private:
+    std::vector<T_out> _cdf;
+    std::vector<T_out> _lut;
+    int _sym_cnt;
+    int _cdf_bits;
+    int _shift;
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class CDFTableCache {
+  /* lru cache of CDFTable keyed on the cdf contents, so that batches with
+   * repeated cdf rows build each table once
+   */
+  public:
+    CDFTableCache(const size_t &capacity, const int &lut_bits = 12){
+        /* capacity:
+         * * max number of tables kept
+         * lut_bits:
+         * * See CDFTable
+         */
+        assert(capacity >= 1);
+        _capacity = capacity;
+        _lut_bits = lut_bits;
+    }
+    ~CDFTableCache(){}
+    const CDFTable<T_out> &get(const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+        /* args: See ArithmeticCodingDecoder
+         * the returned table stays valid until capacity other cdfs are looked up
+         */
+        if(!_lru.empty() && _lru.front().second.matches(sym_cnt, cdf, cdf_bits))
+            return _lru.front().second;
+        uint64_t key = _hash(sym_cnt, cdf, cdf_bits);
+        auto it = _index.find(key);
+        if(it != _index.end()){
+            if(it->second->second.matches(sym_cnt, cdf, cdf_bits)){
+                _lru.splice(_lru.begin(), _lru, it->second);
+                return _lru.front().second;
+            }
+            _lru.erase(it->second);
+            _index.erase(it);
+        }
+        if(_lru.size() >= _capacity){
+            _index.erase(_lru.back().first);
+            _lru.pop_back();
+        }
+        _lru.emplace_front(key, CDFTable<T_out>(sym_cnt, cdf, cdf_bits, _lut_bits));
+        _index[key] = _lru.begin();
+        return _lru.front().second;
+    }
+    size_t size() const { return _lru.size(); }
+  private:
+    static uint64_t _hash(const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+        /* fnv-1a */
+        uint64_t h = 14695981039346656037ull;
+        h = (h ^ static_cast<uint64_t>(sym_cnt)) * 1099511628211ull;
+        h = (h ^ static_cast<uint64_t>(cdf_bits)) * 1099511628211ull;
+        for(int i = 0; i <= sym_cnt; i++)
+            h = (h ^ static_cast<uint64_t>(cdf[i])) * 1099511628211ull;
+        return h;
+    }
+    std::list<std::pair<uint64_t, CDFTable<T_out> > > _lru;
+    std::unordered_map<uint64_t, typename std::list<std::pair<uint64_t, CDFTable<T_out> > >::iterator> _index;
+    size_t _capacity;
+    int _lut_bits;
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class AdaptiveCDF {
+  /* cdf that learns from the coded symbols, following the multi-symbol cdf adaptation of av1:
+   * after each symbol every cdf entry moves 1 / 2 ** rate of the way towards the symbol,
+   * one pass over the cdf with no division, which the compiler vectorizes. cdf[i] - i is the
+   * adapted part, so every bin keeps a frequency >= 1 and the total stays 2 ** cdf_bits.
+   * the encoder and the decoder must update the model with the same symbols in the same order,
+   * so it fits ArithmeticCodingEncoder and RangeCodingEncoder but not rans, which decodes backwards.
+   */
+  public:
+    AdaptiveCDF(const int &sym_cnt, const int &cdf_bits = 15, const int &rate = 0, const T_out *init = nullptr){
+        /* sym_cnt:
+         * * alphabet size, 2 <= sym_cnt <= 2 ** cdf_bits
+         * cdf_bits:
+         * * See ArithmeticCodingEncoder
+         * * default: 15
+         * rate:
+         * * 0: av1 schedule, 2 ** rate grows from 16 to 64 (128 for sym_cnt > 2) over the first 32 symbols
+         * * > 0: fixed rate
+         * init:
+         * * initial cdf with sym_cnt + 1 entries, every bin >= 1, nullptr for uniform
+         */
+        assert(sym_cnt >= 2 && cdf_bits < std::numeric_limits<T_out>::digits && (static_cast<int64_t>(1) << cdf_bits) >= sym_cnt);
+        assert(rate >= 0 && rate < cdf_bits);
+        _sym_cnt = sym_cnt;
+        _cdf_bits = cdf_bits;
+        _rate = rate;
+        int log2_cnt = 0;
+        while((2 << log2_cnt) <= sym_cnt) log2_cnt++;
+        _rate_base = 3 + std::min(log2_cnt, 2);
+        _init.resize(sym_cnt + 1);
+        const int64_t top = (static_cast<int64_t>(1) << cdf_bits) - sym_cnt;
+        for(int i = 0; i <= sym_cnt; i++){
+            _init[i] = init ? init[i] : static_cast<T_out>(i + top * i / sym_cnt);
+            assert(i == 0 || _init[i] > _init[i - 1]);
+        }
+        assert(_init[0] == 0 && static_cast<int64_t>(_init[sym_cnt]) == (static_cast<int64_t>(1) << cdf_bits));
+        reset();
+    }
+    ~AdaptiveCDF(){}
+    void update(const T_out &sym){
+        /* move the cdf towards sym, call after coding sym */
+        const int rate = _rate > 0 ? _rate : _rate_base + (_count > 15) + (_count > 31);
+        const T_out top = static_cast<T_out>((static_cast<int64_t>(1) << _cdf_bits) - _sym_cnt);
+        T_out *cdf = _cdf.data();
+        for(int i = 1; i <= static_cast<int>(sym); i++)
+            cdf[i] -= (cdf[i] - i) >> rate;
+        for(int i = static_cast<int>(sym) + 1; i < _sym_cnt; i++)
+            cdf[i] += (top + i - cdf[i]) >> rate;
+        if(_count < 32) _count++;
+    }
+    void reset(){
+        /* back to the initial cdf, e.g. at the start of a new frame */
+        _cdf = _init;
+        _count = 0;
+    }
+    const T_out *cdf() const { return _cdf.data(); }
+    int sym_cnt() const { return _sym_cnt; }
+    int cdf_bits() const { return _cdf_bits; }
+  private:
+    std::vector<T_out> _cdf;
+    std::vector<T_out> _init;
+    int _sym_cnt;
+    int _cdf_bits;
+    int _rate;
+    int _rate_base;
+    int _count;
+};
+class BitModel {
+  /* adaptive probability of a binary symbol, as the bit model of the lzma range coder:
+   * p() is the probability of 0 in units of 1 / 2 ** prob_bits, after each bit it moves
+   * 1 / 2 ** shift of the way towards the coded bit, and stays within [1, 2 ** prob_bits - 1]
+   */
+  public:
+    static const int prob_bits = 12;
+    BitModel(const int &shift = 4, const int &p = 1 << (prob_bits - 1)){
+        /* shift:
+         * * adaptation speed, 4 learns fast, 5 (lzma) or 6 is steadier
+         * * default: 4
+         * p:
+         * * initial probability of 0, default: 1 / 2
+         */
+        assert(shift >= 1 && shift < prob_bits);
+        assert(p > 0 && p < (1 << prob_bits));
+        _p = static_cast<uint16_t>(p);
+        _shift = static_cast<uint8_t>(shift);
+    }
+    void update(const int &bit){
+        if(bit)
+            _p -= _p >> _shift;
+        else
+            _p += ((1 << prob_bits) - _p) >> _shift;
+    }
+    int p() const { return _p; }
+  private:
+    uint16_t _p;
+    uint8_t _shift;
+};
+enum class Distribution : uint8_t {
+    GAUSSIAN = 0,
+    LAPLACE = 1,
+    LOGISTIC = 2
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class ParametricCDFBank {
+  /* quantized cdf of a zero mean distribution at each scale of a scale table, as the
+   * indexed gaussian conditional of compressai. a value y with mean m and scale s is coded
+   * as q = round(y - m) with the cdf of the first table scale >= s, and decoded as q + m.
+   * cdf k covers q in [-center(k), center(k)] and the two edge bins hold the tail mass, every
+   * bin has frequency >= 1. by default one more bin of frequency 1 is the escape bin of
+   * encode_escape, so q outside is still coded exactly; without it q outside is clamped.
+   */
+  public:
+    ParametricCDFBank(const Distribution &dist, const std::vector<double> &scale_table, const int &cdf_bits, const double &tail_mass = 1e-9, const bool &escape = true){
+        /* dist:
+         * * GAUSSIAN (scale is the std), LAPLACE or LOGISTIC
+         * scale_table:
+         * * ascending scales, See default_scale_table
+         * cdf_bits:
+         * * See ArithmeticCodingEncoder
+         * tail_mass:
+         * * probability left out of [-center(k), center(k)], sets the alphabet size of each cdf
+         * * center(k) is capped at 2 ** cdf_bits / 4
+         * escape:
+         * * add the escape bin, false clamps q to the alphabet, which is lossy
+         */
+        assert(!scale_table.empty() && std::is_sorted(scale_table.begin(), scale_table.end()) && scale_table[0] > 0);
+        assert(tail_mass > 0 && tail_mass < 1);
+        _dist = dist;
+        _scale_table = scale_table;
+        _cdf_bits = cdf_bits;
+        _escape = escape;
+        for(size_t k = 0; k < scale_table.size(); k++){
+            double scale = scale_table[k];
+            /* at most half of the cdf range goes to the frequency floor of 1 */
+            int max_center = static_cast<int>(std::min<int64_t>((static_cast<int64_t>(1) << cdf_bits) / 4, 1 << 20));
+            int center = 0;
+            while(center < max_center && _upper(scale, center + 0.5) >= tail_mass / 2) center++;
+            int sym_cnt = 2 * center + 1 + static_cast<int>(escape);
+            std::vector<T_out> cdf(sym_cnt + 1);
+            _quantize(scale, center, cdf.data());
+            _center.push_back(center);
+            _tables.emplace_back(sym_cnt, cdf.data(), cdf_bits);
+        }
+    }
+    ~ParametricCDFBank(){}
+    static std::vector<double> default_scale_table(const double &min = 0.11, const double &max = 256, const int &levels = 64){
+        /* levels scales evenly spaced in log between min and max, as compressai */
+        std::vector<double> scale_table(levels);
+        for(int k = 0; k < levels; k++)
+            scale_table[k] = std::exp(std::log(min) + (std::log(max) - std::log(min)) * k / std::max(levels - 1, 1));
+        return scale_table;
+    }
+    template <typename T_float>
+    int index(const T_float &scale) const {
+        /* index of the first table scale >= scale, the last one for larger scales */
+        size_t k = std::lower_bound(_scale_table.begin(), _scale_table.end(), static_cast<double>(scale)) - _scale_table.begin();
+        return static_cast<int>(std::min(k, _scale_table.size() - 1));
+    }
+    template <typename T_float>
+    T_out symbol(const int &k, const T_float &value, const T_float &mean) const {
+        /* symbol of value in cdf k, clamped to [0, 2 * center(k)] */
+        double q = std::nearbyint(static_cast<double>(value) - static_cast<double>(mean));
+        q = std::min(std::max(q, static_cast<double>(-_center[k])), static_cast<double>(_center[k]));
+        return static_cast<T_out>(static_cast<int>(q) + _center[k]);
+    }
+    template <typename T_float>
+    int64_t escape_symbol(const int &k, const T_float &value, const T_float &mean) const {
+        /* symbol of value in cdf k without clamping, for encode_escape. values outside
+         * [0, 2 * center(k)] are escaped, |q| >= 2 ** 62 or nan throw std::invalid_argument
+         */
+        double q = std::nearbyint(static_cast<double>(value) - static_cast<double>(mean));
+        if(!(std::fabs(q) < 4611686018427387904.0))
+            throw std::invalid_argument("parametric coding: value - mean out of the int64 range");
+        return static_cast<int64_t>(q) + _center[k];
+    }
+    template <typename T_float>
+    T_float value(const int &k, const int64_t &sym, const T_float &mean) const {
+        /* decoded value of sym in cdf k */
+        return static_cast<T_float>(sym - _center[k]) + mean;
+    }
+    const T_out *cdf(const int &k) const { return _tables[k].cdf(); }
+    const CDFTable<T_out> &table(const int &k) const { return _tables[k]; }
+    int sym_cnt(const int &k) const { return 2 * _center[k] + 1 + static_cast<int>(_escape); }
+    int center(const int &k) const { return _center[k]; }
+    bool escape() const { return _escape; }
+    int cdf_bits() const { return _cdf_bits; }
+    int size() const { return static_cast<int>(_scale_table.size()); }
+  private:
+    double _lower(const double &scale, const double &x) const {
+        /* P(X < x) */
+        double z = x / scale;
+        switch(_dist){
+            case Distribution::GAUSSIAN: return 0.5 * std::erfc(-z / std::sqrt(2.0));
+            case Distribution::LAPLACE: return z < 0 ? 0.5 * std::exp(z) : 1 - 0.5 * std::exp(-z);
+            case Distribution::LOGISTIC: return 1 / (1 + std::exp(-z));
+        }
+        return 0;
+    }
+    double _upper(const double &scale, const double &x) const {
+        /* P(X >= x), the distributions are symmetric */
+        return _lower(scale, -x);
+    }
+    void _quantize(const double &scale, const int &center, T_out *cdf) const {
+        int sym_cnt = 2 * center + 1 + static_cast<int>(_escape);
+        int64_t total = static_cast<int64_t>(1) << _cdf_bits;
+        int64_t spare = total - sym_cnt;
+        std::vector<int64_t> freq(sym_cnt, 1);
+        int64_t sum = static_cast<int64_t>(_escape);
+        int max_sym = 0;
+        for(int i = 0; i < 2 * center + 1; i++){
+            double low = i == 0 ? 0 : _lower(scale, i - center - 0.5);
+            double high = i == 2 * center ? 1 : _lower(scale, i - center + 0.5);
+            freq[i] = 1 + static_cast<int64_t>(std::floor((high - low) * spare));
+            sum += freq[i];
+            if(freq[i] > freq[max_sym]) max_sym = i;
+        }
+        /* rounding down leaves 0 <= total - sum < sym_cnt, given to the most likely bin */
+        freq[max_sym] += total - sum;
+        cdf[0] = 0;
+        for(int i = 0; i < sym_cnt; i++)
+            cdf[i + 1] = static_cast<T_out>(cdf[i] + freq[i]);
+    }
+    Distribution _dist;
+    std::vector<double> _scale_table;
+    std::vector<int> _center;
+    std::vector<CDFTable<T_out> > _tables;
+    int _cdf_bits;
+    bool _escape;
+};
+template <typename T_in, typename T_out, int Precision = 0>
 /* T_in: 
  * * internal type doing computation. 
  * * default: uint64_t
  * T_out: 
  * * interface type for io.
  * * default: uint32_t for cxx, int32 for python
+ * Precision:
+ * * precision fixed at compile time so the range constants fold, 0 to set it at run time only
+ * * default: 0
  */
 class ArithmeticCodingEncoder {
   /* according to paper: ARITHMETIC CODING FOR DATA COMPRESSION
    */
   public:
     BitStream bit_stream;
-    ArithmeticCodingEncoder(const int &precision){
+    ArithmeticCodingEncoder(const int &precision = Precision > 0 ? Precision : 32){
         /* precision: 
          * * aka Code_value_bits
          * * internal precision of arithmetic coding
          * * following paper ARITHMETIC CODING FOR DATA COMPRESSION
          * * requires:
          * * f \le c - 2 && f + c \le p
-         * * default: 32
+         * * default: 32, or Precision
          */
+        static_assert(Precision == 0 || (Precision >= 2 && Precision < std::numeric_limits<T_in>::digits), "bad Precision");
+        assert(Precision == 0 || precision == Precision);
         assert(precision >= 2 && precision < std::numeric_limits<decltype(_full_range)>::digits);
         _precision = precision;
     	_full_range = (static_cast<decltype(_full_range)>(1) << _precision) - 1;
@@ -116,11 +1165,16 @@ class ArithmeticCodingEncoder {
         _three_forth_range = _quarter_range * 3;
         int max_total_bits = std::min(_precision - 2, std::numeric_limits<decltype(_full_range)>::digits - _precision);
         _max_total = (static_cast<decltype(_full_range)>(1) << max_total_bits) - 1;
+        reset();
+    }
+    ~ArithmeticCodingEncoder(){}
+    void reset(){
+        /* start a new stream, bit_stream keeps its capacity */
+        bit_stream.clear();
         _low = 0;
         _high = _full_range;
         _pending_bits = 0;
     }
-    ~ArithmeticCodingEncoder(){}
     void encode(const T_out &sym, const T_out *cdf, const int &cdf_bits){
         /* sym:
          * * symbol to encode, start from 0, should statisfy 0 <= sym < sym_cnt (alphabet size)
@@ -131,51 +1185,103 @@ class ArithmeticCodingEncoder {
          * * 2 ** cdf_bits == last element of cdf, always <= _frequency_bits
          */
         assert(_low < _high);
-        assert((_low & _full_range) == _low);
-        assert((_high & _full_range) == _high);
+        assert((_low & _full()) == _low);
+        assert((_high & _full()) == _high);
         T_in range = _high - _low + 1;
         T_in c_total = static_cast<decltype(c_total)>(1) << cdf_bits;
         assert(c_total <= _max_total);
         T_in c_low = cdf[sym];
         T_in c_high = cdf[sym + 1];
         assert(c_low != c_high);
+        YAECL_STAT(_stats.add(c_high - c_low, cdf_bits));
         _high = _low + ((c_high * range) >> cdf_bits) - 1;
         _low  = _low + ((c_low  * range) >> cdf_bits);
         _renormalize();
     }
+    template <int CDF_BITS>
+    void encode(const T_out &sym, const T_out *cdf){
+        /* encode with cdf_bits fixed at compile time */
+        encode(sym, cdf, CDF_BITS);
+    }
+    void encode(const T_out &sym, AdaptiveCDF<T_out> &model){
+        /* model:
+         * * adaptive cdf, updated with sym after coding
+         */
+        encode(sym, model.cdf(), model.cdf_bits());
+        model.update(sym);
+    }
     void flush(){
         /* call before the end of encoding */
         _pending_bits++;
-        bool bit = static_cast<bool>(_low >= _quarter_range);
-        bit_stream.push_back(bit);        
-        for (; _pending_bits > 0; _pending_bits--)
-            bit_stream.push_back(!bit);
+        _push_pending(static_cast<bool>(_low >= _quarter()));
+        bit_stream.drain();
+    }
+    void encode_bypass(const uint32_t &value, const int &bits){
+        /* value:
+         * * bits equiprobable bits, coded as one symbol of probability 2 ** -bits, no cdf
+         * bits:
+         * * 1 <= bits <= bypass_bits()
+         */
+        assert(bits >= 1 && bits <= bypass_bits() && (static_cast<uint64_t>(value) >> bits) == 0);
+        const T_out cdf[2] = {static_cast<T_out>(value), static_cast<T_out>(value + 1)};
+        encode(0, cdf, bits);
+    }
+    int bypass_bits() const {
+        /* max bits of one encode_bypass, the same for the decoder of this precision */
+        return std::min(16, std::min(static_cast<int>(_precision) - 2, std::numeric_limits<T_in>::digits - static_cast<int>(_precision) - 1) - 1);
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats, kept across reset() until reset_stats() */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
     }
   private:
     void _renormalize(){
         while(1){
-            if(_high < _half_range){
-                bit_stream.push_back(0);        
-                for (; _pending_bits > 0; _pending_bits--)
-                    bit_stream.push_back(1);
-            } else if (_low >= _half_range){
-                bit_stream.push_back(1);        
-                for (; _pending_bits > 0; _pending_bits--)
-                    bit_stream.push_back(0);
-                _low -= _half_range;
-                _high -= _half_range;
-            }else if(_low>=_quarter_range&&_high<_three_forth_range){
+            if(_high < _half()){
+                _push_pending(0);
+            } else if (_low >= _half()){
+                _push_pending(1);
+                _low -= _half();
+                _high -= _half();
+            }else if(_low>=_quarter()&&_high<_three_forth()){
                 assert(_pending_bits < std::numeric_limits<decltype(_pending_bits)>::max());
                 _pending_bits++;
-                _low-=_quarter_range;
-                _high-=_quarter_range;
+                YAECL_STAT(_stats.pending++);
+                _low-=_quarter();
+                _high-=_quarter();
             }else{
                 break;
             }
             _high = (_high << 1) + 1;
             _low <<=1;
+            YAECL_STAT(_stats.renorm++);
+        }
+    }
+    void _push_pending(const bool &bit){
+        /* push bit followed by _pending_bits of !bit, in one append when it fits */
+        YAECL_STAT(_stats.max_pending = std::max(_stats.max_pending, static_cast<int64_t>(_pending_bits)));
+        if(_pending_bits < 56){
+            int n = static_cast<int>(_pending_bits);
+            uint64_t run = (static_cast<uint64_t>(1) << n) - 1;
+            bit_stream.push_bits(bit ? ~run : run, n + 1);
+        }else{
+            bit_stream.push_back(bit);
+            bit_stream.push_bit_run(!bit, static_cast<uint64_t>(_pending_bits));
         }
+        _pending_bits = 0;
     }
+    static constexpr int _k_precision = Precision > 0 ? Precision : 2;
+    T_in _full() const { return Precision > 0 ? (static_cast<T_in>(1) << _k_precision) - 1 : _full_range; }
+    T_in _half() const { return Precision > 0 ? static_cast<T_in>(1) << (_k_precision - 1) : _half_range; }
+    T_in _quarter() const { return Precision > 0 ? static_cast<T_in>(1) << (_k_precision - 2) : _quarter_range; }
+    T_in _three_forth() const { return Precision > 0 ? static_cast<T_in>(3) << (_k_precision - 2) : _three_forth_range; }
     T_in _precision;
     T_in _full_range;
     T_in _half_range;
@@ -185,19 +1291,25 @@ class ArithmeticCodingEncoder {
     T_in _low;
     T_in _high;
     T_in _pending_bits;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
 };
-template <typename T_in, typename T_out>
+template <typename T_in, typename T_out, int Precision = 0>
 /* template args: see ArithmeticCodingEncoder */
 class ArithmeticCodingDecoder{
   public:
     BitStream bit_stream;
-    ArithmeticCodingDecoder(const int &precision, const BitStream &encode_bit_stream){
+    ArithmeticCodingDecoder(const int &precision, BitStream encode_bit_stream){
         /* precision: 
          * * See ArithmeticCodingEncoder
          * encode_bit_stream:
          * * the BitStream ro decode from encoder / read from file
+         * * copied, unless moved in or made by BitStream::view
          */
-        bit_stream = encode_bit_stream;
+        bit_stream = std::move(encode_bit_stream);
+        static_assert(Precision == 0 || (Precision >= 2 && Precision < std::numeric_limits<T_in>::digits), "bad Precision");
+        assert(Precision == 0 || precision == Precision);
         assert(precision >= 2 && precision < std::numeric_limits<decltype(_full_range)>::digits);
         _precision = precision;
     	_full_range = (static_cast<decltype(_full_range)>(1) << _precision) - 1;
@@ -206,16 +1318,17 @@ class ArithmeticCodingDecoder{
         _three_forth_range = _quarter_range * 3;
         _max_total = (static_cast<decltype(_full_range)>(1) << (_precision - 2)) - 1;
         _max_total = std::min(_max_total, (static_cast<decltype(_full_range)>(1) << (std::numeric_limits<decltype(_full_range)>::digits - _precision - 1)) - 1);
-        _low = 0;
-        _high = _full_range;
-        _pending_bits = 0;
-        _code = 0;
-        for(int i=0;i<_precision;i++){
-            _code <<= 1;
-            _code += static_cast<int>(bit_stream.pop_front());
-        }
+        _start();
     }
     ~ArithmeticCodingDecoder(){}
+    void reset(const BitStream &encode_bit_stream){
+        /* decode another stream with the same precision, args: See ArithmeticCodingDecoder
+         * the bytes are copied into the buffer of bit_stream, which keeps its capacity,
+         * so it does not allocate once large enough. a view is not copied
+         */
+        bit_stream = encode_bit_stream;
+        _start();
+    }
     T_out decode(const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
         /* sym_cnt:
          * * sym_cnt is the alphabet size
@@ -225,52 +1338,110 @@ class ArithmeticCodingDecoder{
          * cdf_bits:
          * * 2 ** cdf_bits == last element of cdf, always <= _frequency_bits
          */
+        T_in range = _high - _low + 1;
+        T_in scaled_value = _scaled_value(range, cdf_bits);
+        T_out sym = cdf_search(sym_cnt, cdf, scaled_value);
+        _update(range, cdf[sym], cdf[sym + 1], cdf_bits);
+        return sym;
+    }
+    template <int CDF_BITS>
+    T_out decode(const int &sym_cnt, const T_out *cdf){
+        /* decode with cdf_bits fixed at compile time */
+        return decode(sym_cnt, cdf, CDF_BITS);
+    }
+    T_out decode(AdaptiveCDF<T_out> &model){
+        /* model:
+         * * See encode(sym, model)
+         */
+        T_out sym = decode(model.sym_cnt(), model.cdf(), model.cdf_bits());
+        model.update(sym);
+        return sym;
+    }
+    T_out decode(const CDFTable<T_out> &table){
+        /* table:
+         * * cdf prepared by CDFTable, same result as decode(sym_cnt, cdf, cdf_bits)
+         */
+        T_in range = _high - _low + 1;
+        T_in scaled_value = _scaled_value(range, table.cdf_bits());
+        T_out sym = table.find(scaled_value);
+        _update(range, table.cdf()[sym], table.cdf()[sym + 1], table.cdf_bits());
+        return sym;
+    }
+    uint32_t decode_bypass(const int &bits){
+        /* args: See ArithmeticCodingEncoder::encode_bypass */
+        assert(bits >= 1 && bits <= bypass_bits());
+        T_in range = _high - _low + 1;
+        T_in value = _scaled_value(range, bits);
+        _update(range, value, value + 1, bits);
+        return static_cast<uint32_t>(value);
+    }
+    int bypass_bits() const {
+        /* See ArithmeticCodingEncoder::bypass_bits */
+        return std::min(16, std::min(static_cast<int>(_precision) - 2, std::numeric_limits<T_in>::digits - static_cast<int>(_precision) - 1) - 1);
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+    void _start(){
+        _low = 0;
+        _high = _full_range;
+        _pending_bits = 0;
+        _code = 0;
+        for(int i=0;i<static_cast<int>(_precision);i++){
+            _code <<= 1;
+            _code += static_cast<int>(bit_stream.pop_front());
+        }
+    }
+    T_in _scaled_value(const T_in &range, const int &cdf_bits){
         T_in c_total = static_cast<decltype(c_total)>(1) << cdf_bits;
         assert(c_total <= _max_total);
-        T_in range = _high - _low + 1;
         T_in scaled_range = _code - _low;
         T_in scaled_value = (((scaled_range + 1) << cdf_bits) - 1) / range;
         assert(scaled_value < c_total);
-        T_in start = 0;
-        T_in end = sym_cnt;
-        while (end - start > 1) {
-            T_in middle = (start + end) >> 1;
-            if (cdf[middle] > scaled_value)
-                end = middle;
-            else
-                start = middle;
-        }
-        assert(start + 1 == end);
-        T_in sym = start;
-        T_in c_low = cdf[sym];
-        T_in c_high = cdf[sym + 1];
+        return scaled_value;
+    }
+    void _update(const T_in &range, const T_in &c_low, const T_in &c_high, const int &cdf_bits){
         assert(c_low != c_high);
+        YAECL_STAT(_stats.add(c_high - c_low, cdf_bits));
         _high = _low + ((c_high * range) >> cdf_bits) - 1;
         _low  = _low + ((c_low  * range) >> cdf_bits);
         _renormalize();
-        return static_cast<T_out>(sym);
     }
-  private:
     void _renormalize(){
         while(1){
-            if(_high < _half_range){
+            if(_high < _half()){
                 // pass
-            }else if(_low >= _half_range){
-                _code -= _half_range;
-                _low -= _half_range;
-                _high -= _half_range;
-            }else if(_low >= _quarter_range && _high < _three_forth_range){
-                _code -= _quarter_range;
-                _low -= _quarter_range;
-                _high -= _quarter_range;
+            }else if(_low >= _half()){
+                _code -= _half();
+                _low -= _half();
+                _high -= _half();
+            }else if(_low >= _quarter() && _high < _three_forth()){
+                _code -= _quarter();
+                _low -= _quarter();
+                _high -= _quarter();
             }else{
                 break;
             }
             _high = (_high << 1) + 1;
             _low <<=1;
             _code = (_code << 1) + static_cast<int>(bit_stream.pop_front());
+            YAECL_STAT(_stats.renorm++);
         }
     }
+    static constexpr int _k_precision = Precision > 0 ? Precision : 2;
+    T_in _full() const { return Precision > 0 ? (static_cast<T_in>(1) << _k_precision) - 1 : _full_range; }
+    T_in _half() const { return Precision > 0 ? static_cast<T_in>(1) << (_k_precision - 1) : _half_range; }
+    T_in _quarter() const { return Precision > 0 ? static_cast<T_in>(1) << (_k_precision - 2) : _quarter_range; }
+    T_in _three_forth() const { return Precision > 0 ? static_cast<T_in>(3) << (_k_precision - 2) : _three_forth_range; }
     T_in _precision;
     T_in _full_range;
     T_in _half_range;
@@ -281,57 +1452,545 @@ class ArithmeticCodingDecoder{
     T_in _high;
     T_in _pending_bits;
     T_in _code;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
 };
-template <typename T_in, typename T_out>
+template <typename T_in, typename T_out, int Precision = 0>
 /* template args: see ArithmeticCodingEncoder */
-class RANSCodec {
+class RangeCodingEncoder {
+  /* byte renormalizing range coder, carry propagation follows the lzma rc:
+   * a byte that may still receive a carry is held in _cache, followed by
+   * _cache_size - 1 pending 0xff bytes
+   */
   public:
     BitStream bit_stream;
-    RANSCodec(const int &h_precision, const int &t_precision){
-        /* h_precision: 
-         * * precision for head part, divided by 8
-         * * t_precision < h_precision <= t_precision * 2
-         * * the larger it is, the more precise the pdf you can have
-         * * but also leads to more overhead in flush()
-         * * default: 64
-         * t_precision:
-         * * precision for tail part, divided by 8
-         * * the larger it is, the faster rans is
-         * * but also leads to more overhead in flush()
+    RangeCodingEncoder(const int &precision = Precision > 0 ? Precision : 32){
+        /* precision:
+         * * bits of range, multiple of 8
+         * * requires:
+         * * cdf_bits <= precision - 16 && precision + 8 < digits of T_in
          * * default: 32
          */
-        _h_precision = h_precision;
-        _t_precision = t_precision;
-        assert(_h_precision % 8 == 0);
-        assert(_t_precision % 8 == 0);
+        static_assert(Precision == 0 || (Precision % 8 == 0 && Precision >= 24 && Precision + 8 < std::numeric_limits<T_in>::digits), "bad Precision");
+        assert(Precision == 0 || precision == Precision);
+        assert(precision % 8 == 0 && precision >= 24 && precision + 8 < std::numeric_limits<T_in>::digits);
+        _precision = precision;
+        _top = static_cast<T_in>(1) << (_precision - 8);
+        reset();
+    }
+    ~RangeCodingEncoder(){}
+    void reset(){
+        /* start a new stream, bit_stream keeps its capacity */
+        bit_stream.clear();
+        _low = 0;
+        _range = (static_cast<T_in>(1) << _precision) - 1;
+        _cache = 0;
+        _cache_size = 1;
+        _has_cache = false;
+    }
+    void encode(const T_out &sym, const T_out *cdf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder */
+        assert(cdf_bits <= _prec() - 16);
+        T_in r = _range >> cdf_bits;
+        T_in c_low = cdf[sym];
+        T_in c_high = cdf[sym + 1];
+        assert(c_low != c_high);
+        YAECL_STAT(_stats.add(c_high - c_low, cdf_bits));
+        _low += r * c_low;
+        if(c_high == (static_cast<T_in>(1) << cdf_bits))
+            _range -= r * c_low;
+        else
+            _range = r * (c_high - c_low);
+        while(_range < _top_value()){
+            _range <<= 8;
+            _shift_low();
+        }
+    }
+    template <int CDF_BITS>
+    void encode(const T_out &sym, const T_out *cdf){
+        /* encode with cdf_bits fixed at compile time */
+        encode(sym, cdf, CDF_BITS);
+    }
+    void encode(const T_out &sym, AdaptiveCDF<T_out> &model){
+        /* model:
+         * * adaptive cdf, updated with sym after coding
+         */
+        encode(sym, model.cdf(), model.cdf_bits());
+        model.update(sym);
+    }
+    void encode_bit(const int &bit, const int &p){
+        /* binary fast path, one multiply and no cdf
+         * bit:
+         * * 0 or 1
+         * p:
+         * * probability of 0 in units of 1 / 2 ** BitModel::prob_bits, 0 < p < 2 ** BitModel::prob_bits
+         */
+        assert(p > 0 && p < (1 << BitModel::prob_bits));
+        T_in bound = (_range >> BitModel::prob_bits) * static_cast<T_in>(p);
+        YAECL_STAT(_stats.add(bit ? (1 << BitModel::prob_bits) - p : p, static_cast<int>(BitModel::prob_bits)));
+        if(bit){
+            _low += bound;
+            _range -= bound;
+        }
+        else{
+            _range = bound;
+        }
+        while(_range < _top_value()){
+            _range <<= 8;
+            _shift_low();
+        }
+    }
+    void encode_bit(const int &bit, BitModel &model){
+        /* model:
+         * * adaptive probability, updated with bit after coding
+         */
+        encode_bit(bit, model.p());
+        model.update(bit);
+    }
+    void encode_bits(const uint8_t *bits, const int64_t &n, const uint16_t *p){
+        /* bits:
+         * * n bits, one per byte
+         * p:
+         * * probability of 0 of each bit, See encode_bit
+         */
+        for(int64_t i = 0; i < n; i++)
+            encode_bit(bits[i], p[i]);
+    }
+    void encode_bits(const uint8_t *bits, const int64_t &n, BitModel *models, const int32_t *ctx){
+        /* models:
+         * * adaptive probabilities, one per context
+         * ctx:
+         * * context of each bit, index into models, nullptr codes every bit with models[0]
+         */
+        for(int64_t i = 0; i < n; i++)
+            encode_bit(bits[i], models[ctx ? ctx[i] : 0]);
+    }
+    void flush(){
+        /* call before the end of encoding */
+        for(int i = 0; i <= _prec() / 8; i++)
+            _shift_low();
+        bit_stream.drain();
+    }
+    void encode_bypass(const uint32_t &value, const int &bits){
+        /* args: See ArithmeticCodingEncoder::encode_bypass */
+        assert(bits >= 1 && bits <= bypass_bits() && (static_cast<uint64_t>(value) >> bits) == 0);
+        const T_out cdf[2] = {static_cast<T_out>(value), static_cast<T_out>(value + 1)};
+        encode(0, cdf, bits);
+    }
+    int bypass_bits() const {
+        /* See ArithmeticCodingEncoder::bypass_bits */
+        return std::min(16, _prec() - 16);
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats, kept across reset() until reset_stats() */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+    void _shift_low(){
+        YAECL_STAT(_stats.renorm++);
+        if(_low < (static_cast<T_in>(0xff) << (_prec() - 8)) || (_low >> _prec()) != 0){
+            uint8_t carry = static_cast<uint8_t>(_low >> _prec());
+            YAECL_STAT(_stats.carries += carry);
+            uint8_t byte = _cache;
+            do{
+                /* the first cache byte is a placeholder that never receives a carry */
+                if(_has_cache) bit_stream.push_back_byte(static_cast<uint8_t>(byte + carry));
+                _has_cache = true;
+                byte = 0xff;
+            }while(--_cache_size != 0);
+            _cache = static_cast<uint8_t>(_low >> (_prec() - 8));
+        }
+        else{
+            /* a 0xff byte, held back until the next byte shows whether it gets a carry */
+            YAECL_STAT(_stats.pending++, _stats.max_pending = std::max(_stats.max_pending, static_cast<int64_t>(_cache_size)));
+        }
+        _cache_size++;
+        _low = (_low & (_top_value() - 1)) << 8;
+    }
+    static constexpr int _k_precision = Precision > 0 ? Precision : 24;
+    int _prec() const { return Precision > 0 ? _k_precision : _precision; }
+    T_in _top_value() const { return Precision > 0 ? static_cast<T_in>(1) << (_k_precision - 8) : _top; }
+    int _precision;
+    T_in _top;
+    T_in _low;
+    T_in _range;
+    uint8_t _cache;
+    uint64_t _cache_size;
+    bool _has_cache;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
+};
+template <typename T_in, typename T_out, int Precision = 0>
+/* template args: see ArithmeticCodingEncoder */
+class RangeCodingDecoder {
+  public:
+    BitStream bit_stream;
+    RangeCodingDecoder(const int &precision, BitStream encode_bit_stream){
+        /* precision:
+         * * See RangeCodingEncoder
+         * encode_bit_stream:
+         * * the BitStream ro decode from encoder / read from file
+         * * copied, unless moved in or made by BitStream::view
+         */
+        bit_stream = std::move(encode_bit_stream);
+        static_assert(Precision == 0 || (Precision % 8 == 0 && Precision >= 24 && Precision + 8 < std::numeric_limits<T_in>::digits), "bad Precision");
+        assert(Precision == 0 || precision == Precision);
+        assert(precision % 8 == 0 && precision >= 24 && precision + 8 < std::numeric_limits<T_in>::digits);
+        _precision = precision;
+        _top = static_cast<T_in>(1) << (_precision - 8);
+        _start();
+    }
+    ~RangeCodingDecoder(){}
+    void reset(const BitStream &encode_bit_stream){
+        /* decode another stream with the same precision, args: See RangeCodingDecoder, ArithmeticCodingDecoder::reset */
+        bit_stream = encode_bit_stream;
+        _start();
+    }
+    T_out decode(const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+        /* args: See ArithmeticCodingDecoder */
+        assert(cdf_bits <= _prec() - 16);
+        T_in r = _range >> cdf_bits;
+        T_in scaled_value = std::min(_code / r, (static_cast<T_in>(1) << cdf_bits) - 1);
+        T_out sym = cdf_search(sym_cnt, cdf, scaled_value);
+        _update(r, cdf[sym], cdf[sym + 1], cdf_bits);
+        return sym;
+    }
+    template <int CDF_BITS>
+    T_out decode(const int &sym_cnt, const T_out *cdf){
+        /* decode with cdf_bits fixed at compile time */
+        return decode(sym_cnt, cdf, CDF_BITS);
+    }
+    T_out decode(AdaptiveCDF<T_out> &model){
+        /* model:
+         * * See encode(sym, model)
+         */
+        T_out sym = decode(model.sym_cnt(), model.cdf(), model.cdf_bits());
+        model.update(sym);
+        return sym;
+    }
+    int decode_bit(const int &p){
+        /* args: See RangeCodingEncoder::encode_bit */
+        assert(p > 0 && p < (1 << BitModel::prob_bits));
+        T_in bound = (_range >> BitModel::prob_bits) * static_cast<T_in>(p);
+        int bit;
+        if(_code < bound){
+            _range = bound;
+            bit = 0;
+        }
+        else{
+            _code -= bound;
+            _range -= bound;
+            bit = 1;
+        }
+        YAECL_STAT(_stats.add(bit ? (1 << BitModel::prob_bits) - p : p, static_cast<int>(BitModel::prob_bits)));
+        while(_range < _top_value()){
+            _code = (_code << 8) | bit_stream.pop_front_byte();
+            _range <<= 8;
+            YAECL_STAT(_stats.renorm++);
+        }
+        return bit;
+    }
+    int decode_bit(BitModel &model){
+        /* args: See RangeCodingEncoder::encode_bit */
+        int bit = decode_bit(model.p());
+        model.update(bit);
+        return bit;
+    }
+    void decode_bits(uint8_t *out, const int64_t &n, const uint16_t *p){
+        /* args: See RangeCodingEncoder::encode_bits */
+        for(int64_t i = 0; i < n; i++)
+            out[i] = static_cast<uint8_t>(decode_bit(p[i]));
+    }
+    void decode_bits(uint8_t *out, const int64_t &n, BitModel *models, const int32_t *ctx){
+        /* args: See RangeCodingEncoder::encode_bits, models must start from the same state as the encoder's */
+        for(int64_t i = 0; i < n; i++)
+            out[i] = static_cast<uint8_t>(decode_bit(models[ctx ? ctx[i] : 0]));
+    }
+    T_out decode(const CDFTable<T_out> &table){
+        /* args: See ArithmeticCodingDecoder */
+        assert(table.cdf_bits() <= _prec() - 16);
+        T_in r = _range >> table.cdf_bits();
+        T_in scaled_value = std::min(_code / r, (static_cast<T_in>(1) << table.cdf_bits()) - 1);
+        T_out sym = table.find(scaled_value);
+        _update(r, table.cdf()[sym], table.cdf()[sym + 1], table.cdf_bits());
+        return sym;
+    }
+    uint32_t decode_bypass(const int &bits){
+        /* args: See ArithmeticCodingEncoder::encode_bypass */
+        assert(bits >= 1 && bits <= bypass_bits());
+        T_in r = _range >> bits;
+        T_in value = std::min(_code / r, (static_cast<T_in>(1) << bits) - 1);
+        _update(r, value, value + 1, bits);
+        return static_cast<uint32_t>(value);
+    }
+    int bypass_bits() const {
+        /* See ArithmeticCodingEncoder::bypass_bits */
+        return std::min(16, _prec() - 16);
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+    void _start(){
+        _range = (static_cast<T_in>(1) << _precision) - 1;
+        _code = 0;
+        for(int i = 0; i < _precision / 8; i++)
+            _code = (_code << 8) | bit_stream.pop_front_byte();
+    }
+    void _update(const T_in &r, const T_in &c_low, const T_in &c_high, const int &cdf_bits){
+        assert(c_low != c_high);
+        YAECL_STAT(_stats.add(c_high - c_low, cdf_bits));
+        _code -= r * c_low;
+        if(c_high == (static_cast<T_in>(1) << cdf_bits))
+            _range -= r * c_low;
+        else
+            _range = r * (c_high - c_low);
+        while(_range < _top_value()){
+            _code = (_code << 8) | bit_stream.pop_front_byte();
+            _range <<= 8;
+            YAECL_STAT(_stats.renorm++);
+        }
+    }
+    static constexpr int _k_precision = Precision > 0 ? Precision : 24;
+    int _prec() const { return Precision > 0 ? _k_precision : _precision; }
+    T_in _top_value() const { return Precision > 0 ? static_cast<T_in>(1) << (_k_precision - 8) : _top; }
+    int _precision;
+    T_in _top;
+    T_in _range;
+    T_in _code;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
+};
+template <typename T>
+inline T mulhi(const T &a, const T &b){
+    /* high half of the full a * b product, for any unsigned T */
+    const int h = sizeof(T) * 4;
+    const T mask = (static_cast<T>(1) << h) - 1;
+    T a0 = a & mask, a1 = a >> h;
+    T b0 = b & mask, b1 = b >> h;
+    T p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    T mid = (p00 >> h) + (p01 & mask) + (p10 & mask);
+    return p11 + (p01 >> h) + (p10 >> h) + (mid >> h);
+}
+#if defined(__SIZEOF_INT128__)
+inline uint64_t mulhi(const uint64_t &a, const uint64_t &b){
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+}
+#endif
+template <typename T_in>
+/* template args: see ArithmeticCodingEncoder */
+struct RANSEncSymbol {
+    /* encoding constants of one symbol, following RansEncSymbol of ryg_rans
+     * x_max:
+     * * renormalize while state >= x_max
+     * rcp_freq, rcp_shift:
+     * * state / freq == mulhi(state, rcp_freq) >> rcp_shift, or one less
+     */
+    T_in x_max;
+    T_in rcp_freq;
+    int rcp_shift;
+    T_in freq;
+    T_in start;
+};
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class RANSEncTable {
+  /* per cdf RANSEncSymbol table, so that RANSCodec::encode replaces the 64 bit
+   * divide and modulo with a multiply-high and a shift
+   */
+  public:
+    RANSEncTable(const int &sym_cnt, const T_out *cdf, const int &cdf_bits, const int &h_precision){
+        /* sym_cnt, cdf, cdf_bits:
+         * * See ArithmeticCodingDecoder
+         * h_precision:
+         * * See RANSCodec, must match the codec that uses the table
+         */
+        const int digits = sizeof(T_in) * 8;
+        _cdf_bits = cdf_bits;
+        _symbols.resize(sym_cnt);
+        for(int i = 0; i < sym_cnt; i++){
+            RANSEncSymbol<T_in> &es = _symbols[i];
+            es.start = cdf[i];
+            es.freq = cdf[i + 1] - cdf[i];
+            es.x_max = es.freq << (h_precision - cdf_bits);
+            if(es.freq == 0){
+                /* never coded */
+                es.rcp_freq = 0;
+                es.rcp_shift = 0;
+                continue;
+            }
+            int shift = 0;
+            while((static_cast<T_in>(2) << shift) <= es.freq) shift++;
+            es.rcp_shift = shift;
+            if((es.freq & (es.freq - 1)) == 0){
+                /* 2 ** (digits + shift) / freq does not fit, use the largest value instead */
+                es.rcp_freq = ~static_cast<T_in>(0);
+                continue;
+            }
+            /* floor(2 ** (digits + shift) / freq) by long division */
+            T_in rem = 1;
+            T_in quo = 0;
+            for(int b = 0; b < digits + shift; b++){
+                rem <<= 1;
+                quo <<= 1;
+                if(rem >= es.freq){
+                    rem -= es.freq;
+                    quo |= 1;
+                }
+            }
+            es.rcp_freq = quo;
+        }
+    }
+    ~RANSEncTable(){}
+    const RANSEncSymbol<T_in> &operator[](const T_out &sym) const { return _symbols[sym]; }
+    int cdf_bits() const { return _cdf_bits; }
+  private:
+    std::vector<RANSEncSymbol<T_in> > _symbols;
+    int _cdf_bits;
+};
+template <typename T_in>
+/* template args: see ArithmeticCodingEncoder */
+struct RANSSnapshot {
+    /* position of a RANSCodec, See RANSCodec::snapshot */
+    T_in state;
+    int64_t pos;
+    size_t undo;
+};
+template <typename T_in, typename T_out, int H_precision = 0, int T_precision = 0>
+/* template args: see ArithmeticCodingEncoder
+ * H_precision, T_precision:
+ * * h_precision and t_precision fixed at compile time, 0 to set them at run time only
+ * * default: 0
+ */
+class RANSCodec {
+  public:
+    BitStream bit_stream;
+    RANSCodec(const int &h_precision = H_precision > 0 ? H_precision : 64, const int &t_precision = T_precision > 0 ? T_precision : 32){
+        /* h_precision: 
+         * * precision for head part, divided by 8
+         * * t_precision < h_precision <= t_precision * 2
+         * * the larger it is, the more precise the pdf you can have
+         * * but also leads to more overhead in flush()
+         * * default: 64
+         * t_precision:
+         * * precision for tail part, divided by 8
+         * * the larger it is, the faster rans is
+         * * but also leads to more overhead in flush()
+         * * default: 32
+         */
+        static_assert((H_precision == 0) == (T_precision == 0), "set both H_precision and T_precision or none");
+        assert(H_precision == 0 || (h_precision == H_precision && t_precision == T_precision));
+        _h_precision = h_precision;
+        _t_precision = t_precision;
+        assert(_h_precision % 8 == 0);
+        assert(_t_precision % 8 == 0);
         assert(_t_precision < _h_precision);
         assert(_h_precision <= _t_precision * 2);
         _h_min = static_cast<decltype(_h_min)>(1) << (_h_precision - _t_precision);
-        _state = _h_min; // max state
+        reset();
     }
-    RANSCodec(const int &h_precision, const int &t_precision, const BitStream &encode_bit_stream){
+    RANSCodec(BitStream encode_bit_stream): RANSCodec(H_precision > 0 ? H_precision : 64, T_precision > 0 ? T_precision : 32, std::move(encode_bit_stream)) {}
+    RANSCodec(const int &h_precision, const int &t_precision, BitStream encode_bit_stream){
+        static_assert((H_precision == 0) == (T_precision == 0), "set both H_precision and T_precision or none");
+        assert(H_precision == 0 || (h_precision == H_precision && t_precision == T_precision));
         _h_precision = h_precision;
         _t_precision = t_precision;
         _h_min = static_cast<decltype(_h_min)>(1) << (_h_precision - _t_precision);
-        bit_stream = encode_bit_stream;
-        _state = 0;
-        for(int i = 1; i <= _h_precision / 8; i++){
-            _state <<= 8;
-            uint8_t byte = bit_stream.pop_back_byte();
-            _state |= byte;
-        }
+        bit_stream = std::move(encode_bit_stream);
+        _start();
     }
     ~RANSCodec(){}
+    void reset(){
+        /* start a new stream for encoding, bit_stream keeps its capacity */
+        bit_stream.clear();
+        _state = _h_min; // max state
+        _info_origin = info_bits();
+    }
+    void reset(const BitStream &encode_bit_stream){
+        /* decode another stream with the same precisions, args: See RANSCodec, ArithmeticCodingDecoder::reset */
+        bit_stream = encode_bit_stream;
+        _start();
+    }
+    RANSSnapshot<T_in> snapshot(){
+        /* O(1) checkpoint for bits-back coding: the state, the stream size and a mark of the
+         * stream undo log, the bytes are not copied. encode / decode on, then restore to drop
+         * everything since, e.g. to try another latent. snapshots nest, call release once per
+         * snapshot (last first) when it is no longer needed
+         */
+        RANSSnapshot<T_in> snap;
+        snap.state = _state;
+        snap.pos = bit_stream.size();
+        snap.undo = bit_stream.mark();
+        return snap;
+    }
+    void restore(const RANSSnapshot<T_in> &snap){
+        /* back to snap, which stays valid until released, so it can be restored again.
+         * snapshots taken after snap can only be released afterwards
+         */
+        bit_stream.rewind(snap.pos, snap.undo);
+        _state = snap.state;
+    }
+    void release(){
+        /* drop the last snapshot */
+        bit_stream.unmark();
+    }
+    void prefill(const int64_t &bytes, const uint64_t &seed = 0){
+        /* seed the stack with clean bits for bits-back coding, instead of encoding dummy symbols:
+         * pushes bytes random bytes and sets the state to random h_precision bits (top bit set),
+         * so the first decodes pop these bits. resets net_bits
+         */
+        uint64_t x = seed;
+        for(int64_t i = 0; i < bytes; i++)
+            bit_stream.push_back_byte(static_cast<uint8_t>(_splitmix64(x)));
+        T_in state = 0;
+        for(int i = 1; i <= _h() / 8; i++)
+            state = (state << 8) | static_cast<T_in>(_splitmix64(x) & 0xff);
+        _state = state | (static_cast<T_in>(1) << (_h() - 1));
+        _info_origin = info_bits();
+    }
+    double info_bits(){
+        /* information held by the codec: stream bits + log2(state), encoding a symbol of
+         * probability p adds about -log2(p) and decoding it takes that back
+         */
+        return static_cast<double>(bit_stream.size()) + (_state ? std::log2(static_cast<double>(_state)) : 0.0);
+    }
+    double net_bits(){
+        /* info_bits gained since construction, prefill or reset_net_bits, negative when more was popped than pushed */
+        return info_bits() - _info_origin;
+    }
+    void reset_net_bits(){
+        _info_origin = info_bits();
+    }
     void encode(const T_out &sym, const T_out *cdf, const int &cdf_bits){
         /* args: See ArithmeticCodingEncoder */
         T_in c_low = cdf[sym];
         T_in c_range = cdf[sym + 1] - c_low;
         T_in c_total = static_cast<decltype(c_total)>(1) << cdf_bits;
         T_in state = _state;
-        T_in state_max = c_range << (_h_precision - cdf_bits);
+        T_in state_max = c_range << (_h() - cdf_bits);
+        YAECL_STAT(_stats.add(c_range, cdf_bits));
         if(state >= state_max){
+            YAECL_STAT(_stats.renorm++);
             T_in mask = 0xff;
-            for(int i = 1; i <= _t_precision / 8; i++){
+            for(int i = 1; i <= _t() / 8; i++){
                 bit_stream.push_back_byte(static_cast<uint8_t>(state & mask));
                 state >>= 8;
             }
@@ -339,50 +1998,1247 @@ class RANSCodec {
         }
         _state = ((state / c_range) << cdf_bits) + (state % c_range) + c_low;
     }
+    void encode(const T_out &sym, const RANSEncTable<T_in, T_out> &table){
+        /* table:
+         * * cdf prepared by RANSEncTable, same result as encode(sym, cdf, cdf_bits) without division
+         */
+        const RANSEncSymbol<T_in> &es = table[sym];
+        T_in state = _state;
+        YAECL_STAT(_stats.add(es.freq, table.cdf_bits()));
+        if(state >= es.x_max){
+            YAECL_STAT(_stats.renorm++);
+            T_in mask = 0xff;
+            for(int i = 1; i <= _t() / 8; i++){
+                bit_stream.push_back_byte(static_cast<uint8_t>(state & mask));
+                state >>= 8;
+            }
+            assert(state < es.x_max);
+        }
+        T_in q = mulhi(state, es.rcp_freq) >> es.rcp_shift;
+        T_in r = state - q * es.freq;
+        if(r >= es.freq){
+            q++;
+            r -= es.freq;
+        }
+        _state = (q << table.cdf_bits()) + r + es.start;
+    }
+    template <int CDF_BITS>
+    void encode(const T_out &sym, const T_out *cdf){
+        /* encode with cdf_bits fixed at compile time */
+        encode(sym, cdf, CDF_BITS);
+    }
     void flush(){
         T_in mask = 0xff;
-        for(int i = 1; i <= _h_precision / 8; i++){
+        for(int i = 1; i <= _h() / 8; i++){
             bit_stream.push_back_byte(static_cast<uint8_t>(_state & mask));
             _state >>= 8;
         }
     }
+    int h_precision() const { return static_cast<int>(_h()); }
     T_out decode(const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
         /* args: See ArithmeticCodingDecoder */
         T_in scaled_value = _state & ((static_cast<decltype(_state)>(1) << cdf_bits) - 1);
-        T_in start = 0;
-        T_in end = sym_cnt;
-        while (end - start > 1) {
-            T_in middle = (start + end) >> 1;
-            if (cdf[middle] > scaled_value)
-                end = middle;
-            else
-                start = middle;
+        T_out sym = cdf_search(sym_cnt, cdf, scaled_value);
+        _update(scaled_value, cdf[sym], cdf[sym + 1], cdf_bits);
+        return sym;
+    }
+    template <int CDF_BITS>
+    T_out decode(const int &sym_cnt, const T_out *cdf){
+        /* decode with cdf_bits fixed at compile time */
+        return decode(sym_cnt, cdf, CDF_BITS);
+    }
+    T_out decode(const CDFTable<T_out> &table){
+        /* args: See ArithmeticCodingDecoder */
+        T_in scaled_value = _state & ((static_cast<decltype(_state)>(1) << table.cdf_bits()) - 1);
+        T_out sym = table.find(scaled_value);
+        _update(scaled_value, table.cdf()[sym], table.cdf()[sym + 1], table.cdf_bits());
+        return sym;
+    }
+    void encode_bypass(const uint32_t &value, const int &bits){
+        /* args: See ArithmeticCodingEncoder::encode_bypass, the bits go to the state as one symbol of frequency 1 */
+        assert(bits >= 1 && bits <= bypass_bits() && (static_cast<uint64_t>(value) >> bits) == 0);
+        const T_out cdf[2] = {static_cast<T_out>(value), static_cast<T_out>(value + 1)};
+        encode(0, cdf, bits);
+    }
+    uint32_t decode_bypass(const int &bits){
+        /* args: See ArithmeticCodingEncoder::encode_bypass */
+        assert(bits >= 1 && bits <= bypass_bits());
+        T_in value = _state & ((static_cast<T_in>(1) << bits) - 1);
+        _update(value, value, value + 1, bits);
+        return static_cast<uint32_t>(value);
+    }
+    int bypass_bits() const {
+        /* max bits of one encode_bypass, one spill of t_precision bits has to make room for them */
+        return std::min(16, _t());
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+    void _start(){
+        /* read the final state of the encoder from the top of bit_stream */
+        _state = 0;
+        for(int i = 1; i <= _h() / 8; i++){
+            _state <<= 8;
+            uint8_t byte = bit_stream.pop_back_byte();
+            _state |= byte;
         }
-        assert(start + 1 == end);
-        T_in sym = start;
-        T_in c_low = cdf[sym];
-        T_in c_range = cdf[sym + 1] - c_low;
+        _info_origin = info_bits();
+    }
+    void _update(const T_in &scaled_value, const T_in &c_low, const T_in &c_high, const int &cdf_bits){
+        T_in c_range = c_high - c_low;
         T_in state = _state;
+        YAECL_STAT(_stats.add(c_range, cdf_bits));
         state = c_range * (state >> cdf_bits) + scaled_value - c_low;
-        if (state < _h_min){
-            for(int i = 1; i <= _t_precision / 8; i++){
+        if (state < _hmin()){
+            YAECL_STAT(_stats.renorm++);
+            for(int i = 1; i <= _t() / 8; i++){
                 state <<= 8;
                 uint8_t byte = bit_stream.pop_back_byte();
                 state |= byte;
             }
-            assert (state >= _h_min);
+            assert (state >= _hmin());
         }
         _state = state;
-        return static_cast<T_out>(sym);
     }
-  private:
+    static uint64_t _splitmix64(uint64_t &x){
+        uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
     T_in _state;
+    double _info_origin;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
+    static constexpr int _k_h = H_precision > 0 ? H_precision : 64;
+    static constexpr int _k_t = T_precision > 0 ? T_precision : 32;
+    int _h() const { return H_precision > 0 ? _k_h : static_cast<int>(_h_precision); }
+    int _t() const { return T_precision > 0 ? _k_t : static_cast<int>(_t_precision); }
+    T_in _hmin() const { return H_precision > 0 && T_precision > 0 ? static_cast<T_in>(1) << (_k_h - _k_t) : _h_min; }
     T_in _h_precision;
     T_in _t_precision;
     T_in _t_mask;
     T_in _h_min;
 };
+template <typename T_in, typename T_out, int N_lane, int H_precision = 0, int T_precision = 0>
+/* template args: see ArithmeticCodingEncoder, RANSCodec
+ * N_lane:
+ * * number of interleaved rans states, 2, 4, 8 or 16
+ */
+class InterleavedRANSCodec {
+  /* N_lane rans states sharing one byte stack, symbol k is coded by state k % N_lane,
+   * so consecutive symbols do not wait on each other's divide / multiply.
+   * encode_n / decode_n process whole groups of N_lane symbols with the lane
+   * states in a flat array, the lane updates run on the simd kernels of rans_lane_update.
+   */
+  static_assert(N_lane >= 2 && N_lane <= 16 && (N_lane & (N_lane - 1)) == 0, "N_lane must be 2, 4, 8 or 16");
+  public:
+    BitStream bit_stream;
+    InterleavedRANSCodec(const int &h_precision = H_precision > 0 ? H_precision : 64, const int &t_precision = T_precision > 0 ? T_precision : 32){
+        /* args: See RANSCodec */
+        static_assert((H_precision == 0) == (T_precision == 0), "set both H_precision and T_precision or none");
+        assert(H_precision == 0 || (h_precision == H_precision && t_precision == T_precision));
+        _h_precision = h_precision;
+        _t_precision = t_precision;
+        assert(_h_precision % 8 == 0);
+        assert(_t_precision % 8 == 0);
+        assert(_t_precision < _h_precision);
+        assert(_h_precision <= _t_precision * 2);
+        _h_min = static_cast<decltype(_h_min)>(1) << (_h_precision - _t_precision);
+        reset();
+    }
+    InterleavedRANSCodec(const int &h_precision, const int &t_precision, BitStream encode_bit_stream){
+        static_assert((H_precision == 0) == (T_precision == 0), "set both H_precision and T_precision or none");
+        assert(H_precision == 0 || (h_precision == H_precision && t_precision == T_precision));
+        _h_precision = h_precision;
+        _t_precision = t_precision;
+        _h_min = static_cast<decltype(_h_min)>(1) << (_h_precision - _t_precision);
+        bit_stream = std::move(encode_bit_stream);
+        _start();
+    }
+    ~InterleavedRANSCodec(){}
+    void reset(){
+        /* start a new stream for encoding, bit_stream keeps its capacity */
+        bit_stream.clear();
+        for(int l = 0; l < N_lane; l++) _state[l] = _h_min;
+        _lane = 0;
+    }
+    void reset(const BitStream &encode_bit_stream){
+        /* decode another stream with the same precisions, args: See RANSCodec, ArithmeticCodingDecoder::reset */
+        bit_stream = encode_bit_stream;
+        _start();
+    }
+    void encode(const T_out &sym, const T_out *cdf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder */
+        T_in c_low = cdf[sym];
+        T_in c_range = cdf[sym + 1] - c_low;
+        YAECL_STAT(_stats.add(c_range, cdf_bits));
+        _renormalize_encode(_lane, c_range, cdf_bits);
+        _state[_lane] = ((_state[_lane] / c_range) << cdf_bits) + (_state[_lane] % c_range) + c_low;
+        _lane = (_lane + 1) & (N_lane - 1);
+    }
+    template <int CDF_BITS>
+    void encode(const T_out &sym, const T_out *cdf){
+        /* encode with cdf_bits fixed at compile time */
+        encode(sym, cdf, CDF_BITS);
+    }
+    void encode_n(const T_out *sym, const int64_t &n, const T_out *cdf, const int64_t &cdf_stride, const int &cdf_bits){
+        /* sym:
+         * * n symbols to encode
+         * cdf:
+         * * cdf of symbol i starts at cdf + i * cdf_stride
+         * * cdf_stride = 0 shares one cdf for all symbols
+         * other args: See ArithmeticCodingEncoder
+         */
+        int64_t i = 0;
+        for(; i < n && _lane != 0; i++)
+            encode(sym[i], cdf + i * cdf_stride, cdf_bits);
+        for(; i + N_lane <= n; i += N_lane){
+            T_in c_low[N_lane];
+            T_in c_range[N_lane];
+            for(int l = 0; l < N_lane; l++){
+                const T_out *c = cdf + (i + l) * cdf_stride;
+                c_low[l] = c[sym[i + l]];
+                c_range[l] = c[sym[i + l] + 1] - c_low[l];
+                YAECL_STAT(_stats.add(c_range[l], cdf_bits));
+            }
+            for(int l = 0; l < N_lane; l++)
+                _renormalize_encode(l, c_range[l], cdf_bits);
+            for(int l = 0; l < N_lane; l++)
+                _state[l] = ((_state[l] / c_range[l]) << cdf_bits) + (_state[l] % c_range[l]) + c_low[l];
+        }
+        for(; i < n; i++)
+            encode(sym[i], cdf + i * cdf_stride, cdf_bits);
+    }
+    void flush(){
+        /* push all lane states and the next lane, so decoding can resume anywhere */
+        T_in mask = 0xff;
+        for(int l = 0; l < N_lane; l++){
+            for(int i = 1; i <= _h() / 8; i++){
+                bit_stream.push_back_byte(static_cast<uint8_t>(_state[l] & mask));
+                _state[l] >>= 8;
+            }
+        }
+        bit_stream.push_back_byte(static_cast<uint8_t>(_lane));
+    }
+    T_out decode(const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+        /* args: See ArithmeticCodingDecoder */
+        _lane = (_lane + N_lane - 1) & (N_lane - 1);
+        T_in scaled_value = _state[_lane] & ((static_cast<T_in>(1) << cdf_bits) - 1);
+        T_in sym = cdf_search(sym_cnt, cdf, scaled_value);
+        T_in c_low = cdf[sym];
+        T_in c_range = cdf[sym + 1] - c_low;
+        YAECL_STAT(_stats.add(c_range, cdf_bits));
+        _state[_lane] = c_range * (_state[_lane] >> cdf_bits) + scaled_value - c_low;
+        _renormalize_decode(_lane);
+        return static_cast<T_out>(sym);
+    }
+    template <int CDF_BITS>
+    T_out decode(const int &sym_cnt, const T_out *cdf){
+        /* decode with cdf_bits fixed at compile time */
+        return decode(sym_cnt, cdf, CDF_BITS);
+    }
+    void decode_n(T_out *out, const int64_t &n, const int &sym_cnt, const T_out *cdf, const int64_t &cdf_stride, const int &cdf_bits){
+        /* out:
+         * * n decoded symbols, in stack order as decode()
+         * other args: See encode_n, ArithmeticCodingDecoder
+         */
+        int64_t i = 0;
+        for(; i < n && _lane != 0; i++)
+            out[i] = decode(sym_cnt, cdf + i * cdf_stride, cdf_bits);
+        T_in mask = (static_cast<T_in>(1) << cdf_bits) - 1;
+        for(; i + N_lane <= n; i += N_lane){
+            /* symbol i + j is decoded by lane N_lane - 1 - j */
+            T_in scaled_value[N_lane];
+            T_in bias[N_lane];
+            T_in c_range[N_lane];
+            for(int l = 0; l < N_lane; l++)
+                scaled_value[l] = _state[l] & mask;
+            for(int j = 0; j < N_lane; j++){
+                int l = N_lane - 1 - j;
+                const T_out *c = cdf + (i + j) * cdf_stride;
+                T_in sym = cdf_search(sym_cnt, c, scaled_value[l]);
+                out[i + j] = static_cast<T_out>(sym);
+                bias[l] = scaled_value[l] - c[sym];
+                c_range[l] = c[sym + 1] - c[sym];
+                YAECL_STAT(_stats.add(c_range[l], cdf_bits));
+            }
+            rans_lane_update(_state, c_range, bias, N_lane, cdf_bits);
+            for(int l = N_lane - 1; l >= 0; l--)
+                _renormalize_decode(l);
+        }
+        for(; i < n; i++)
+            out[i] = decode(sym_cnt, cdf + i * cdf_stride, cdf_bits);
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+    void _start(){
+        /* read the lane of the next symbol and the final lane states from the top of bit_stream */
+        _lane = bit_stream.pop_back_byte();
+        assert(_lane < N_lane);
+        _lane &= N_lane - 1;
+        for(int l = N_lane - 1; l >= 0; l--){
+            T_in state = 0;
+            for(int i = 1; i <= _h_precision / 8; i++){
+                state <<= 8;
+                state |= bit_stream.pop_back_byte();
+            }
+            _state[l] = state;
+        }
+    }
+    void _renormalize_encode(const int &lane, const T_in &c_range, const int &cdf_bits){
+        T_in state_max = c_range << (_h() - cdf_bits);
+        if(_state[lane] >= state_max){
+            YAECL_STAT(_stats.renorm++);
+            T_in mask = 0xff;
+            for(int i = 1; i <= _t() / 8; i++){
+                bit_stream.push_back_byte(static_cast<uint8_t>(_state[lane] & mask));
+                _state[lane] >>= 8;
+            }
+            assert(_state[lane] < state_max);
+        }
+    }
+    void _renormalize_decode(const int &lane){
+        if(_state[lane] < _hmin()){
+            YAECL_STAT(_stats.renorm++);
+            for(int i = 1; i <= _t() / 8; i++){
+                _state[lane] <<= 8;
+                _state[lane] |= bit_stream.pop_back_byte();
+            }
+            assert(_state[lane] >= _hmin());
+        }
+    }
+    T_in _state[N_lane];
+    int _lane;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
+    static constexpr int _k_h = H_precision > 0 ? H_precision : 64;
+    static constexpr int _k_t = T_precision > 0 ? T_precision : 32;
+    int _h() const { return H_precision > 0 ? _k_h : static_cast<int>(_h_precision); }
+    int _t() const { return T_precision > 0 ? _k_t : static_cast<int>(_t_precision); }
+    T_in _hmin() const { return H_precision > 0 && T_precision > 0 ? static_cast<T_in>(1) << (_k_h - _k_t) : _h_min; }
+    int _h_precision;
+    int _t_precision;
+    T_in _h_min;
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class TANSTable {
+  /* tabled ans (fse) tables of one static cdf, table size 2 ** cdf_bits. symbols are spread
+   * over the table with the fse step, decode_entry(x) gives the symbol of state x and how to
+   * read the next state, the encode side follows FSE_buildCTable: one add, one shift and one
+   * lookup per symbol, no multiply or divide.
+   */
+  public:
+    struct DecodeEntry {
+        uint32_t base;
+        uint16_t sym;
+        uint8_t nb_bits;
+    };
+    TANSTable(const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+        /* sym_cnt, cdf, cdf_bits:
+         * * See ArithmeticCodingDecoder, 1 <= cdf_bits <= 20, sym_cnt <= 65536
+         * * zero frequency symbols can not be coded
+         */
+        assert(sym_cnt >= 1 && sym_cnt <= 65536 && cdf_bits >= 1 && cdf_bits <= 20);
+        assert(cdf[0] == 0 && static_cast<int64_t>(cdf[sym_cnt]) == (static_cast<int64_t>(1) << cdf_bits));
+        const uint32_t size = static_cast<uint32_t>(1) << cdf_bits;
+        _cdf_bits = cdf_bits;
+        _decode.resize(size);
+        _encode_state.resize(size);
+        _delta_nb_bits.resize(sym_cnt);
+        _delta_find_state.resize(sym_cnt);
+        _freq.resize(sym_cnt);
+        std::vector<uint16_t> spread(size);
+        const uint32_t step = ((size >> 1) + (size >> 3) + 3) | 1;
+        uint32_t pos = 0;
+        for(int s = 0; s < sym_cnt; s++){
+            for(T_out k = cdf[s]; k < cdf[s + 1]; k++){
+                spread[pos] = static_cast<uint16_t>(s);
+                pos = (pos + step) & (size - 1);
+            }
+        }
+        assert(pos == 0);
+        std::vector<uint32_t> next(sym_cnt);
+        for(int s = 0; s < sym_cnt; s++){
+            uint32_t freq = static_cast<uint32_t>(cdf[s + 1] - cdf[s]);
+            next[s] = freq;
+            _freq[s] = freq;
+            if(freq == 0){
+                _delta_nb_bits[s] = 0;
+                _delta_find_state[s] = 0;
+                continue;
+            }
+            int max_bits_out = cdf_bits - _log2(freq);
+            /* FSE_buildCTable keeps this in 32 bits with a shift of 16, which only holds for table logs <= 16 */
+            _delta_nb_bits[s] = (static_cast<uint64_t>(max_bits_out) << 32) - (static_cast<uint64_t>(freq) << max_bits_out);
+            _delta_find_state[s] = static_cast<int32_t>(cdf[s]) - static_cast<int32_t>(freq);
+        }
+        for(uint32_t u = 0; u < size; u++){
+            uint16_t s = spread[u];
+            uint32_t x = next[s]++;
+            _encode_state[cdf[s] + x - (cdf[s + 1] - cdf[s])] = size + u;
+            int nb_bits = cdf_bits - _log2(x);
+            _decode[u].sym = s;
+            _decode[u].nb_bits = static_cast<uint8_t>(nb_bits);
+            _decode[u].base = (x << nb_bits) - size;
+        }
+    }
+    ~TANSTable(){}
+    int cdf_bits() const { return _cdf_bits; }
+    uint32_t freq(const T_out &sym) const { return _freq[sym]; }
+    const DecodeEntry &decode_entry(const uint32_t &x) const { return _decode[x]; }
+    uint32_t encode_state(const T_out &sym, const uint32_t &x, int &nb_bits) const {
+        /* next encoder state from x in [2 ** cdf_bits, 2 ** (cdf_bits + 1)), the low nb_bits bits of x go to the stream */
+        nb_bits = static_cast<int>((x + _delta_nb_bits[sym]) >> 32);
+        return _encode_state[(x >> nb_bits) + _delta_find_state[sym]];
+    }
+  private:
+    static int _log2(uint32_t v){
+        int r = 0;
+        while(v >>= 1) r++;
+        return r;
+    }
+    std::vector<DecodeEntry> _decode;
+    std::vector<uint32_t> _encode_state;
+    std::vector<uint64_t> _delta_nb_bits;
+    std::vector<int32_t> _delta_find_state;
+    std::vector<uint32_t> _freq;
+    int _cdf_bits;
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class TANSEncoder {
+  /* tabled ans for small static alphabets. ans is lifo, so symbols are coded in blocks:
+   * encode_n walks the block backwards and writes the final state followed by the bits
+   * in the order the decoder reads them, then TANSDecoder reads the stream front to back.
+   * each block costs cdf_bits bits for its state, decode blocks with the same sizes and cdfs.
+   */
+  public:
+    BitStream bit_stream;
+    TANSEncoder(){}
+    ~TANSEncoder(){}
+    void reset(){
+        /* start a new stream, bit_stream and the block buffer keep their capacity */
+        bit_stream.clear();
+    }
+    void encode_n(const T_out *sym, const int64_t &n, const TANSTable<T_out> &table){
+        /* sym:
+         * * n symbols to encode as one block
+         * table:
+         * * tables of the cdf of all symbols
+         */
+        const int cdf_bits = table.cdf_bits();
+        const uint32_t size = static_cast<uint32_t>(1) << cdf_bits;
+        _pending.resize(n);
+        uint32_t x = size;
+        for(int64_t i = n - 1; i >= 0; i--){
+            int nb_bits;
+            uint32_t next = table.encode_state(sym[i], x, nb_bits);
+            YAECL_STAT(_stats.add(table.freq(sym[i]), cdf_bits), _stats.renorm += nb_bits > 0);
+            _pending[i] = ((x & ((static_cast<uint32_t>(1) << nb_bits) - 1)) << 5) | static_cast<uint32_t>(nb_bits);
+            x = next;
+        }
+        bit_stream.push_bits(x - size, cdf_bits);
+        uint64_t acc = 0;
+        int acc_bits = 0;
+        for(int64_t i = 0; i < n; i++){
+            int nb_bits = static_cast<int>(_pending[i] & 31);
+            acc = (acc << nb_bits) | (_pending[i] >> 5);
+            acc_bits += nb_bits;
+            if(acc_bits > 36){
+                bit_stream.push_bits(acc, acc_bits);
+                acc_bits = 0;
+            }
+        }
+        bit_stream.push_bits(acc, acc_bits);
+    }
+    void encode_nx1(const T_out *sym, const int64_t &n, const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+        /* args: See encode_n, ArithmeticCodingEncoder, builds the table of cdf */
+        encode_n(sym, n, TANSTable<T_out>(sym_cnt, cdf, cdf_bits));
+    }
+    void flush(){
+        /* blocks are complete after encode_n, kept for the same calls as the other encoders */
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+    std::vector<uint32_t> _pending;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class TANSDecoder {
+  public:
+    BitStream bit_stream;
+    TANSDecoder(BitStream encode_bit_stream){
+        /* encode_bit_stream:
+         * * See ArithmeticCodingDecoder
+         */
+        bit_stream = std::move(encode_bit_stream);
+    }
+    ~TANSDecoder(){}
+    void reset(const BitStream &encode_bit_stream){
+        /* decode another stream, args: See TANSDecoder, ArithmeticCodingDecoder::reset */
+        bit_stream = encode_bit_stream;
+    }
+    void decode_n(T_out *out, const int64_t &n, const TANSTable<T_out> &table){
+        /* out:
+         * * n decoded symbols of one block written by TANSEncoder::encode_n
+         */
+        uint32_t x = static_cast<uint32_t>(bit_stream.pop_front_bits(table.cdf_bits()));
+        /* the bits are read straight from data() through the 64 bit register acc, msb first */
+        const uint8_t *bytes = bit_stream.data();
+        const int64_t len = bit_stream.byte_size();
+        const int64_t start = bit_stream.front();
+        int64_t next = start / 8;
+        uint64_t acc = 0;
+        int acc_bits = 0;
+        for(; acc_bits <= 56; acc_bits += 8, next++)
+            acc |= static_cast<uint64_t>(next < len ? bytes[next] : 0) << (56 - acc_bits);
+        acc <<= start % 8;
+        acc_bits -= static_cast<int>(start % 8);
+        for(int64_t i = 0; i < n; i++){
+            const typename TANSTable<T_out>::DecodeEntry &e = table.decode_entry(x);
+            out[i] = static_cast<T_out>(e.sym);
+            YAECL_STAT(_stats.add(table.freq(out[i]), table.cdf_bits()), _stats.renorm += e.nb_bits > 0);
+            x = e.base + static_cast<uint32_t>((acc >> 1) >> (63 - e.nb_bits));
+            acc <<= e.nb_bits;
+            acc_bits -= e.nb_bits;
+            if(acc_bits < 24){
+                for(; acc_bits <= 56; acc_bits += 8, next++)
+                    acc |= static_cast<uint64_t>(next < len ? bytes[next] : 0) << (56 - acc_bits);
+            }
+        }
+        assert(x == 0);
+        bit_stream.seek_front(std::min(next * 8 - acc_bits, bit_stream.size()));
+    }
+    void decode_nx1(T_out *out, const int64_t &n, const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+        /* args: See decode_n, ArithmeticCodingDecoder */
+        decode_n(out, n, TANSTable<T_out>(sym_cnt, cdf, cdf_bits));
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
+};
+
 
+enum class CodecType : uint8_t {
+    AC = 0,
+    RANGE = 1,
+    RANS = 2
+};
+struct CodecParams {
+    /* codec:
+     * * ArithmeticCodingEncoder/Decoder, RangeCodingEncoder/Decoder or RANSCodec
+     * precision:
+     * * See ArithmeticCodingEncoder and RangeCodingEncoder
+     * h_precision, t_precision:
+     * * See RANSCodec
+     */
+    CodecType codec;
+    int precision;
+    int h_precision;
+    int t_precision;
+    CodecParams(const CodecType &codec = CodecType::AC, const int &precision = 32, const int &h_precision = 64, const int &t_precision = 32):
+        codec(codec), precision(precision), h_precision(h_precision), t_precision(t_precision) {}
+};
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+BitStream encode_symbols(const CodecParams &params, const T_out *sym, const int64_t &n, const T_out *cdf, const int64_t &cdf_stride, const int &cdf_bits, CodecStats *stats = nullptr){
+    /* encode n symbols into a flushed stream
+     * args: See InterleavedRANSCodec::encode_n
+     * stats: the counters of the codec are merged into it when given, See CodecStats
+     * rans encodes backwards, so decode_symbols returns symbols in order for every codec
+     */
+    switch(params.codec){
+        case CodecType::AC: {
+            ArithmeticCodingEncoder<T_in, T_out> enc(params.precision);
+            for(int64_t i = 0; i < n; i++)
+                enc.encode(sym[i], cdf + i * cdf_stride, cdf_bits);
+            enc.flush();
+            if(stats) stats->merge(enc.stats());
+            return std::move(enc.bit_stream);
+        }
+        case CodecType::RANGE: {
+            RangeCodingEncoder<T_in, T_out> enc(params.precision);
+            for(int64_t i = 0; i < n; i++)
+                enc.encode(sym[i], cdf + i * cdf_stride, cdf_bits);
+            enc.flush();
+            if(stats) stats->merge(enc.stats());
+            return std::move(enc.bit_stream);
+        }
+        case CodecType::RANS: {
+            RANSCodec<T_in, T_out> enc(params.h_precision, params.t_precision);
+            for(int64_t i = n - 1; i >= 0; i--)
+                enc.encode(sym[i], cdf + i * cdf_stride, cdf_bits);
+            enc.flush();
+            if(stats) stats->merge(enc.stats());
+            return std::move(enc.bit_stream);
+        }
+    }
+    assert(false);
+    return BitStream();
+}
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+void decode_symbols(const CodecParams &params, const BitStream &bit_stream, T_out *out, const int64_t &n, const int &sym_cnt, const T_out *cdf, const int64_t &cdf_stride, const int &cdf_bits, CodecStats *stats = nullptr){
+    /* decode n symbols of a stream from encode_symbols
+     * args: See InterleavedRANSCodec::decode_n, encode_symbols
+     */
+    switch(params.codec){
+        case CodecType::AC: {
+            ArithmeticCodingDecoder<T_in, T_out> dec(params.precision, bit_stream);
+            for(int64_t i = 0; i < n; i++)
+                out[i] = dec.decode(sym_cnt, cdf + i * cdf_stride, cdf_bits);
+            if(stats) stats->merge(dec.stats());
+            return;
+        }
+        case CodecType::RANGE: {
+            RangeCodingDecoder<T_in, T_out> dec(params.precision, bit_stream);
+            for(int64_t i = 0; i < n; i++)
+                out[i] = dec.decode(sym_cnt, cdf + i * cdf_stride, cdf_bits);
+            if(stats) stats->merge(dec.stats());
+            return;
+        }
+        case CodecType::RANS: {
+            RANSCodec<T_in, T_out> dec(params.h_precision, params.t_precision, bit_stream);
+            for(int64_t i = 0; i < n; i++)
+                out[i] = dec.decode(sym_cnt, cdf + i * cdf_stride, cdf_bits);
+            if(stats) stats->merge(dec.stats());
+            return;
+        }
+    }
+    assert(false);
+}
+template <typename T_codec, typename T_out, typename T_model>
+void encode_with_model(T_codec &enc, const T_out *sym, const int64_t &n, const int &sym_cnt, const int &cdf_bits, T_model &&model){
+    /* autoregressive coding with a native context model, the cdf of each symbol is asked from model
+     * enc:
+     * * ArithmeticCodingEncoder or RangeCodingEncoder, RANSCodec has its own overload
+     * sym:
+     * * n symbols to encode
+     * model:
+     * * model(i, sym) returns the cdf of symbol i (sym_cnt + 1 bins), it may only read sym[0, i)
+     * * so that decode_with_model sees the same cdfs. the cdf only has to stay valid until the next call
+     * sym_cnt:
+     * * alphabet size, See ArithmeticCodingDecoder
+     */
+    for(int64_t i = 0; i < n; i++)
+        enc.encode(sym[i], model(i, sym), cdf_bits);
+}
+template <typename T_in, typename T_out, int H_precision, int T_precision, typename T_model>
+void encode_with_model(RANSCodec<T_in, T_out, H_precision, T_precision> &enc, const T_out *sym, const int64_t &n, const int &sym_cnt, const int &cdf_bits, T_model &&model){
+    /* args: See encode_with_model, the cdfs are copied in order and coded backwards,
+     * so decode_with_model returns the symbols in order as for the other codecs
+     */
+    const int64_t bins = sym_cnt + 1;
+    std::vector<T_out> cdfs(n * bins);
+    for(int64_t i = 0; i < n; i++){
+        const T_out *cdf = model(i, sym);
+        std::copy(cdf, cdf + bins, cdfs.begin() + i * bins);
+    }
+    for(int64_t i = n - 1; i >= 0; i--)
+        enc.encode(sym[i], cdfs.data() + i * bins, cdf_bits);
+}
+template <typename T_codec, typename T_out, typename T_model>
+void decode_with_model(T_codec &dec, T_out *out, const int64_t &n, const int &sym_cnt, const int &cdf_bits, T_model &&model){
+    /* dec:
+     * * ArithmeticCodingDecoder, RangeCodingDecoder or RANSCodec
+     * out:
+     * * n decoded symbols, model(i, out) reads out[0, i) decoded so far
+     * other args: See encode_with_model
+     */
+    for(int64_t i = 0; i < n; i++)
+        out[i] = dec.decode(sym_cnt, model(i, static_cast<const T_out*>(out)), cdf_bits);
+}
+/* most pieces of _escape_pieces: 64 unary bits and 63 suffix bits one at a time */
+static const int _escape_max_pieces = 127;
+template <typename T_sym>
+int _escape_pieces(const T_sym &sym, const int &sym_cnt, const int &chunk, uint32_t *value, int *bits){
+    /* exp-golomb (order 0) code of an escaped symbol as bypass pieces in decoding order, returns the count.
+     * the escape code e is sym - (sym_cnt - 1) for unsigned T_sym, for signed T_sym the values above the
+     * alphabet and the negative values interleave: e = 2 * (sym - (sym_cnt - 1)) or e = -2 * sym - 1.
+     * e + 1 = 1xxx with n bits x is written as n zero bits, a one bit and the n bits x, chunk at a time.
+     * e + 1 overflows for the min of int64_t and the max of uint64_t, they throw std::invalid_argument,
+     * as does a codec without bypass bits (chunk < 1). at most 64 + 63 pieces, See _escape_max_pieces
+     */
+    if(chunk < 1)
+        throw std::invalid_argument("escape coding: the codec has no bypass bits at this precision");
+    const int64_t esc = sym_cnt - 1;
+    if(std::is_signed<T_sym>::value ? static_cast<int64_t>(sym) == std::numeric_limits<int64_t>::min()
+                                    : static_cast<uint64_t>(sym) == std::numeric_limits<uint64_t>::max())
+        throw std::invalid_argument("escape coding: the min of int64 / max of uint64 has no exp-golomb code");
+    uint64_t e;
+    if(std::is_signed<T_sym>::value && static_cast<int64_t>(sym) < 0)
+        e = 2 * (0 - static_cast<uint64_t>(static_cast<int64_t>(sym))) - 1;
+    else if(std::is_signed<T_sym>::value)
+        e = 2 * (static_cast<uint64_t>(sym) - esc);
+    else
+        e = static_cast<uint64_t>(sym) - esc;
+    uint64_t x = e + 1;
+    int n = 0;
+    while((x >> n) > 1) n++;
+    int cnt = 0;
+    for(int i = 0; i <= n; i++){
+        value[cnt] = i == n;
+        bits[cnt++] = 1;
+    }
+    for(int left = n; left > 0; ){
+        int b = std::min(chunk, left);
+        left -= b;
+        value[cnt] = static_cast<uint32_t>((x >> left) & ((static_cast<uint64_t>(1) << b) - 1));
+        bits[cnt++] = b;
+    }
+    return cnt;
+}
+template <typename T_codec, typename T_sym, typename T_out>
+void encode_escape(T_codec &enc, const T_sym &sym, const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+    /* escape coding: the last bin sym_cnt - 1 of cdf is reserved, symbols in [0, sym_cnt - 1) are coded
+     * as usual and any other value (larger, or negative for signed T_out) codes the escape bin followed
+     * by an exp-golomb code in bypass bits, See encode_bypass, _escape_pieces. so the alphabet only has
+     * to cover where the probability mass is
+     * enc:
+     * * ArithmeticCodingEncoder or RangeCodingEncoder, RANSCodec has its own overload
+     * sym:
+     * * any integer type, negative values only escape when T_sym is signed
+     * * the min of int64_t and the max of uint64_t throw std::invalid_argument, See _escape_pieces
+     * other args: See ArithmeticCodingEncoder
+     */
+    const int64_t esc = sym_cnt - 1;
+    if(static_cast<uint64_t>(sym) < static_cast<uint64_t>(esc)){
+        enc.encode(static_cast<T_out>(sym), cdf, cdf_bits);
+        return;
+    }
+    uint32_t value[_escape_max_pieces];
+    int bits[_escape_max_pieces];
+    int cnt = _escape_pieces(sym, sym_cnt, enc.bypass_bits(), value, bits);
+    enc.encode(static_cast<T_out>(esc), cdf, cdf_bits);
+    for(int k = 0; k < cnt; k++)
+        enc.encode_bypass(value[k], bits[k]);
+}
+template <typename T_in, typename T_sym, typename T_out, int H_precision, int T_precision>
+void encode_escape(RANSCodec<T_in, T_out, H_precision, T_precision> &enc, const T_sym &sym, const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+    /* args: See encode_escape, rans is lifo: the bypass pieces go first and backwards, then the escape bin */
+    const int64_t esc = sym_cnt - 1;
+    if(static_cast<uint64_t>(sym) < static_cast<uint64_t>(esc)){
+        enc.encode(static_cast<T_out>(sym), cdf, cdf_bits);
+        return;
+    }
+    uint32_t value[_escape_max_pieces];
+    int bits[_escape_max_pieces];
+    int cnt = _escape_pieces(sym, sym_cnt, enc.bypass_bits(), value, bits);
+    for(int k = cnt - 1; k >= 0; k--)
+        enc.encode_bypass(value[k], bits[k]);
+    enc.encode(static_cast<T_out>(esc), cdf, cdf_bits);
+}
+template <typename T_codec, typename T_sym>
+T_sym read_escape(T_codec &dec, const T_sym &sym, const int &sym_cnt){
+    /* sym:
+     * * bin just decoded with the cdf of encode_escape, the escaped value is read when it is the escape bin
+     * * returned as T_sym, which has to match the T_sym of encode_escape
+     * dec:
+     * * ArithmeticCodingDecoder, RangeCodingDecoder or RANSCodec
+     */
+    const int64_t esc = sym_cnt - 1;
+    if(static_cast<int64_t>(sym) != esc) return sym;
+    const int chunk = dec.bypass_bits();
+    if(chunk < 1)
+        throw std::invalid_argument("escape coding: the codec has no bypass bits at this precision");
+    int n = 0;
+    while(n < 64 && dec.decode_bypass(1) == 0)
+        n++;
+    assert(n < 64);
+    uint64_t x = 1;
+    for(int left = n; left > 0; ){
+        int b = std::min(chunk, left);
+        left -= b;
+        x = (x << b) | dec.decode_bypass(b);
+    }
+    uint64_t e = x - 1;
+    if(!std::is_signed<T_sym>::value)
+        return static_cast<T_sym>(esc + e);
+    if(e & 1)
+        return static_cast<T_sym>(-static_cast<int64_t>((e + 1) / 2));
+    return static_cast<T_sym>(static_cast<uint64_t>(esc) + e / 2);
+}
+template <typename T_codec, typename T_out>
+T_out decode_escape(T_codec &dec, const int &sym_cnt, const T_out *cdf, const int &cdf_bits){
+    /* args: See encode_escape, read_escape, for a signed T_sym call read_escape with the decoded bin cast to T_sym */
+    return read_escape(dec, dec.decode(sym_cnt, cdf, cdf_bits), sym_cnt);
+}
+class ThreadPool {
+  /* fixed worker threads running one parallel_for at a time, the calling thread
+   * takes part in every job, so ThreadPool(1) runs everything inline
+   */
+  public:
+    ThreadPool(const int &threads){
+        /* threads:
+         * * total threads including the caller, <= 0 for std::thread::hardware_concurrency()
+         */
+        int n = threads > 0 ? threads : static_cast<int>(std::thread::hardware_concurrency());
+        _stop = false;
+        _generation = 0;
+        _active = 0;
+        _n = 0;
+        _next = 0;
+        _fn = nullptr;
+        for(int i = 1; i < n; i++)
+            _workers.emplace_back([this]{ _work(); });
+    }
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        for(auto &worker : _workers)
+            worker.join();
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    void parallel_for(const int64_t &n, const std::function<void(int64_t)> &fn){
+        /* call fn(i) for i in [0, n), in any order and on any thread */
+        std::lock_guard<std::mutex> job_lock(_job_mutex);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _fn = &fn;
+            _n = n;
+            _next = 0;
+            _active = static_cast<int>(_workers.size());
+            _generation++;
+        }
+        _cv.notify_all();
+        _run();
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done_cv.wait(lock, [this]{ return _active == 0; });
+        _fn = nullptr;
+    }
+    int size() const { return static_cast<int>(_workers.size()) + 1; }
+  private:
+    void _run(){
+        for(int64_t i = _next++; i < _n; i = _next++)
+            (*_fn)(i);
+    }
+    void _work(){
+        uint64_t seen = 0;
+        while(1){
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [&]{ return _stop || _generation != seen; });
+                if(_stop) return;
+                seen = _generation;
+            }
+            _run();
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(--_active == 0) _done_cv.notify_one();
+        }
+    }
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::mutex _job_mutex;
+    std::condition_variable _cv;
+    std::condition_variable _done_cv;
+    const std::function<void(int64_t)> *_fn;
+    int64_t _n;
+    std::atomic<int64_t> _next;
+    uint64_t _generation;
+    int _active;
+    bool _stop;
+};
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class ChunkedCodec {
+  /* splits n symbols into independent chunks, each with its own codec state and
+   * substream, so chunks are coded in parallel. chunk k holds symbols
+   * [k * n / chunks, (k + 1) * n / chunks), the layout depends on n and chunks only,
+   * never on the thread count:
+   * * u32 chunk count, u64 symbol count, u64 end offset of each chunk, chunk bytes
+   * * little endian, offsets counted from the first chunk byte
+   */
+  public:
+    ChunkedCodec(const CodecParams &params, const int &chunks, const int &threads): _pool(threads){
+        /* params:
+         * * See CodecParams
+         * chunks:
+         * * number of substreams, more chunks use more cores but cost a flush each
+         * threads:
+         * * See ThreadPool
+         */
+        assert(chunks >= 1);
+        _params = params;
+        _chunks = chunks;
+    }
+    ~ChunkedCodec(){}
+    BitStream encode(const T_out *sym, const int64_t &n, const T_out *cdf, const int64_t &cdf_stride, const int &cdf_bits){
+        /* args: See InterleavedRANSCodec::encode_n */
+        std::vector<BitStream> streams(_chunks);
+        std::vector<CodecStats> stats(_chunks);
+        _pool.parallel_for(_chunks, [&](int64_t k){
+            int64_t begin = _chunk_begin(k, n);
+            int64_t end = _chunk_begin(k + 1, n);
+            streams[k] = encode_symbols<T_in, T_out>(_params, sym + begin, end - begin, cdf + begin * cdf_stride, cdf_stride, cdf_bits, &stats[k]);
+        });
+        for(int k = 0; k < _chunks; k++)
+            YAECL_STAT(_stats.merge(stats[k]));
+        std::vector<uint8_t> header;
+        _put(header, static_cast<uint64_t>(_chunks), 4);
+        _put(header, static_cast<uint64_t>(n), 8);
+        uint64_t offset = 0;
+        for(int k = 0; k < _chunks; k++){
+            offset += streams[k].byte_size();
+            _put(header, offset, 8);
+        }
+        BitStream bit_stream;
+        bit_stream.reserve(header.size() + offset);
+        bit_stream.push_back_bytes(header.data(), header.size());
+        for(int k = 0; k < _chunks; k++)
+            bit_stream.push_back_bytes(streams[k].data(), streams[k].byte_size());
+        return bit_stream;
+    }
+    void decode(BitStream &bit_stream, T_out *out, const int64_t &n, const int &sym_cnt, const T_out *cdf, const int64_t &cdf_stride, const int &cdf_bits){
+        /* bit_stream:
+         * * stream from encode, chunk count is read from the header
+         * other args: See InterleavedRANSCodec::decode_n
+         */
+        const uint8_t *data = bit_stream.data();
+        const uint64_t len = static_cast<uint64_t>(bit_stream.byte_size());
+        /* the header is checked here, before any worker runs, so a truncated or
+         * corrupt stream throws std::runtime_error on the calling thread
+         */
+        if(len < 12)
+            throw std::runtime_error("chunked stream: truncated header");
+        const uint64_t count = _get(data, 4);
+        if(count < 1 || count > static_cast<uint64_t>(INT32_MAX))
+            throw std::runtime_error("chunked stream: bad chunk count");
+        if(static_cast<int64_t>(_get(data + 4, 8)) != n)
+            throw std::runtime_error("chunked stream: symbol count does not match n");
+        const int chunks = static_cast<int>(count);
+        const uint64_t base = 12 + 8 * count;
+        if(len < base)
+            throw std::runtime_error("chunked stream: truncated chunk offsets");
+        std::vector<uint64_t> stops(chunks);
+        for(int k = 0; k < chunks; k++){
+            stops[k] = _get(data + 12 + 8 * k, 8);
+            if(stops[k] < (k == 0 ? 0 : stops[k - 1]) || stops[k] > len - base)
+                throw std::runtime_error("chunked stream: chunk offset out of bounds");
+        }
+        std::vector<CodecStats> stats(chunks);
+        _pool.parallel_for(chunks, [&](int64_t k){
+            uint64_t start = k == 0 ? 0 : stops[k - 1];
+            uint64_t stop = stops[k];
+            int64_t begin = k * n / chunks;
+            int64_t end = (k + 1) * n / chunks;
+            BitStream chunk = BitStream::view(data + base + start, static_cast<size_t>(stop - start));
+            decode_symbols<T_in, T_out>(_params, chunk, out + begin, end - begin, sym_cnt, cdf + begin * cdf_stride, cdf_stride, cdf_bits, &stats[k]);
+        });
+        for(int k = 0; k < chunks; k++)
+            YAECL_STAT(_stats.merge(stats[k]));
+    }
+    const CodecStats &stats() const {
+        /* See CodecStats, summed over the chunks of every encode / decode */
+#ifdef YAECL_ENABLE_STATS
+        return _stats;
+#else
+        return CodecStats::none();
+#endif
+    }
+    void reset_stats(){
+        YAECL_STAT(_stats.reset());
+    }
+  private:
+    int64_t _chunk_begin(const int64_t &k, const int64_t &n) const { return k * n / _chunks; }
+    static void _put(std::vector<uint8_t> &bytes, const uint64_t &value, const int &len){
+        for(int i = 0; i < len; i++)
+            bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    static uint64_t _get(const uint8_t *bytes, const int &len){
+        uint64_t value = 0;
+        for(int i = 0; i < len; i++)
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        return value;
+    }
+    CodecParams _params;
+    int _chunks;
+    ThreadPool _pool;
+#ifdef YAECL_ENABLE_STATS
+    CodecStats _stats;
+#endif
+};
+struct SubstreamInfo {
+    /* index entry of a substream in a StreamContainer
+     * name:
+     * * free form tag, e.g. "z" and "y" of a hyperprior model, or the frame number
+     * codec, precision, h_precision, t_precision:
+     * * codec that wrote the substream, See CodecParams
+     * cdf_bits:
+     * * See ArithmeticCodingEncoder
+     * sym_count:
+     * * number of symbols in the substream, 0 if not given
+     * offset, length:
+     * * bytes of the substream, offset counted from the first byte of the container
+     */
+    std::string name;
+    CodecType codec;
+    int precision;
+    int h_precision;
+    int t_precision;
+    int cdf_bits;
+    uint64_t sym_count;
+    uint64_t offset;
+    uint64_t length;
+    CodecParams params() const { return CodecParams(codec, precision, h_precision, t_precision); }
+};
+class StreamContainer {
+  /* several substreams in one stream with an index up front, so that any substream is
+   * decoded without reading the others, e.g. for region of interest or frame seeking.
+   * with open, the file is memory mapped and only the index and the substreams decoded
+   * are read from disk. layout:
+   * * "YAEC", u8 version, u32 substream count
+   * * per substream: u8 codec, u8 precision, u8 h_precision, u8 t_precision, u8 cdf_bits,
+   *   u64 symbol count, u64 offset, u64 length, u16 name length, name bytes
+   * * substream bytes, in index order
+   * * little endian
+   */
+  public:
+    static const int version = 1;
+    StreamContainer(){}
+    StreamContainer(BitStream bit_stream){
+        /* bit_stream:
+         * * container from write / save, usually a view, e.g. BitStream::map
+         * * the substreams are views of it, kept alive by them
+         * * a bad magic or version, or an index entry past the end, throws std::runtime_error
+         */
+        std::shared_ptr<BitStream> whole = std::make_shared<BitStream>(std::move(bit_stream));
+        const uint8_t *data = whole->data();
+        const uint64_t len = static_cast<uint64_t>(whole->byte_size());
+        if(len < 9 || data[0] != 'Y' || data[1] != 'A' || data[2] != 'E' || data[3] != 'C')
+            throw std::runtime_error("stream container: bad magic");
+        if(data[4] != version)
+            throw std::runtime_error("stream container: unsupported version");
+        const uint64_t count = _get(data + 5, 4);
+        uint64_t pos = 9;
+        for(uint64_t k = 0; k < count; k++){
+            if(len - pos < 31)
+                throw std::runtime_error("stream container: truncated index");
+            if(data[pos] > static_cast<uint8_t>(CodecType::RANS))
+                throw std::runtime_error("stream container: unknown codec");
+            SubstreamInfo info;
+            info.codec = static_cast<CodecType>(data[pos]);
+            info.precision = data[pos + 1];
+            info.h_precision = data[pos + 2];
+            info.t_precision = data[pos + 3];
+            info.cdf_bits = data[pos + 4];
+            info.sym_count = _get(data + pos + 5, 8);
+            info.offset = _get(data + pos + 13, 8);
+            info.length = _get(data + pos + 21, 8);
+            const uint64_t name_len = _get(data + pos + 29, 2);
+            pos += 31;
+            if(len - pos < name_len)
+                throw std::runtime_error("stream container: truncated index");
+            if(info.offset > len || info.length > len - info.offset)
+                throw std::runtime_error("stream container: substream out of bounds");
+            info.name.assign(reinterpret_cast<const char*>(data + pos), static_cast<size_t>(name_len));
+            pos += name_len;
+            _index.push_back(info);
+            _streams.push_back(BitStream::view(data + info.offset, static_cast<size_t>(info.length), whole));
+        }
+    }
+    static StreamContainer open(const std::string &fpath){
+        /* container of a file from save, memory mapped, See BitStream::map */
+        return StreamContainer(BitStream::map(fpath));
+    }
+    ~StreamContainer(){}
+    int add(const std::string &name, BitStream bit_stream, const CodecParams &params, const int &cdf_bits, const uint64_t &sym_count = 0){
+        /* name, sym_count:
+         * * See SubstreamInfo
+         * bit_stream:
+         * * flushed stream of the substream, copied unless moved in or a view
+         * params, cdf_bits:
+         * * codec of bit_stream, stored for the decoder
+         * return: index of the substream
+         */
+        assert(name.size() < (1 << 16) && cdf_bits >= 0 && cdf_bits < 256);
+        SubstreamInfo info;
+        info.name = name;
+        info.codec = params.codec;
+        info.precision = params.precision;
+        info.h_precision = params.h_precision;
+        info.t_precision = params.t_precision;
+        info.cdf_bits = cdf_bits;
+        info.sym_count = sym_count;
+        info.offset = 0;
+        info.length = static_cast<uint64_t>(bit_stream.byte_size());
+        _index.push_back(info);
+        _streams.push_back(std::move(bit_stream));
+        return static_cast<int>(_index.size()) - 1;
+    }
+    int size() const { return static_cast<int>(_index.size()); }
+    const SubstreamInfo &info(const int &k) const {
+        /* k out of range throws std::out_of_range */
+        return _index.at(k);
+    }
+    int find(const std::string &name) const {
+        /* index of the first substream called name, -1 if there is none */
+        for(size_t k = 0; k < _index.size(); k++)
+            if(_index[k].name == name) return static_cast<int>(k);
+        return -1;
+    }
+    BitStream substream(const int &k) const {
+        /* stream of substream k to construct its decoder with, a view when the container was read
+         * k out of range throws std::out_of_range
+         */
+        return _streams.at(k);
+    }
+    BitStream write(){
+        /* the whole container, offsets of the index are updated */
+        std::vector<uint8_t> header;
+        header.insert(header.end(), {'Y', 'A', 'E', 'C', static_cast<uint8_t>(version)});
+        _put(header, _index.size(), 4);
+        uint64_t offset = 9;
+        for(const SubstreamInfo &info : _index)
+            offset += 31 + info.name.size();
+        for(size_t k = 0; k < _index.size(); k++){
+            SubstreamInfo &info = _index[k];
+            info.offset = offset;
+            offset += info.length;
+            header.push_back(static_cast<uint8_t>(info.codec));
+            header.push_back(static_cast<uint8_t>(info.precision));
+            header.push_back(static_cast<uint8_t>(info.h_precision));
+            header.push_back(static_cast<uint8_t>(info.t_precision));
+            header.push_back(static_cast<uint8_t>(info.cdf_bits));
+            _put(header, info.sym_count, 8);
+            _put(header, info.offset, 8);
+            _put(header, info.length, 8);
+            _put(header, info.name.size(), 2);
+            header.insert(header.end(), info.name.begin(), info.name.end());
+        }
+        BitStream bit_stream;
+        bit_stream.reserve(static_cast<size_t>(offset));
+        bit_stream.push_back_bytes(header.data(), header.size());
+        for(size_t k = 0; k < _streams.size(); k++)
+            bit_stream.push_back_bytes(_streams[k].data(), _index[k].length);
+        return bit_stream;
+    }
+    void save(const std::string &fpath){
+        write().save(fpath);
+    }
+  private:
+    static void _put(std::vector<uint8_t> &bytes, const uint64_t &value, const int &len){
+        for(int i = 0; i < len; i++)
+            bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    static uint64_t _get(const uint8_t *bytes, const int &len){
+        uint64_t value = 0;
+        for(int i = 0; i < len; i++)
+            value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        return value;
+    }
+    std::vector<SubstreamInfo> _index;
+    std::vector<BitStream> _streams;
+};
+template <typename T_encoder, typename T_out, typename T_float>
+/* template args:
+ * * T_encoder: ArithmeticCodingEncoder, RangeCodingEncoder or RANSCodec
+ * * T_out: see ArithmeticCodingEncoder
+ * * T_float: float or double
+ */
+void encode_param(T_encoder &encoder, const ParametricCDFBank<T_out> &bank, const T_float *values, const T_float *means, const T_float *scales, const int64_t &n){
+    /* code n values with the bank cdf picked by their scale, no cdf is built per value
+     * values, means, scales:
+     * * See ParametricCDFBank, with the escape bin of the bank any value is coded exactly
+     */
+    for(int64_t i = 0; i < n; i++){
+        int k = bank.index(scales[i]);
+        if(bank.escape())
+            encode_escape(encoder, bank.escape_symbol(k, values[i], means[i]), bank.sym_cnt(k), bank.cdf(k), bank.cdf_bits());
+        else
+            encoder.encode(bank.symbol(k, values[i], means[i]), bank.cdf(k), bank.cdf_bits());
+    }
+}
+template <typename T_decoder, typename T_out, typename T_float>
+/* template args: see encode_param */
+void decode_param(T_decoder &decoder, const ParametricCDFBank<T_out> &bank, const T_float *means, const T_float *scales, T_float *out, const int64_t &n){
+    /* decode n values coded by encode_param, out[i] = q + means[i]
+     * for RANSCodec, means and scales are read in the order of decoding
+     */
+    for(int64_t i = 0; i < n; i++){
+        int k = bank.index(scales[i]);
+        int64_t sym = static_cast<int64_t>(decoder.decode(bank.table(k)));
+        if(bank.escape())
+            sym = read_escape(decoder, sym, bank.sym_cnt(k));
+        out[i] = bank.value(k, sym, means[i]);
+    }
+}
+template <typename T_encoder, typename T_out>
+/* template args:
+ * * T_encoder: ArithmeticCodingEncoder or RangeCodingEncoder
+ * * T_out: see ArithmeticCodingEncoder
+ */
+void encode_adaptive(T_encoder &encoder, AdaptiveCDF<T_out> *const *models, const T_out *sym, const int32_t *ctx, const int64_t &n){
+    /* code n symbols with adaptive cdfs, single pass and no cdf from the caller
+     * models:
+     * * adaptive cdfs, one per context
+     * ctx:
+     * * context of each symbol, index into models, nullptr codes every symbol with models[0]
+     */
+    for(int64_t i = 0; i < n; i++)
+        encoder.encode(sym[i], *models[ctx ? ctx[i] : 0]);
+}
+template <typename T_decoder, typename T_out>
+/* template args:
+ * * T_decoder: ArithmeticCodingDecoder or RangeCodingDecoder
+ * * T_out: see ArithmeticCodingEncoder
+ */
+void decode_adaptive(T_decoder &decoder, AdaptiveCDF<T_out> *const *models, const int32_t *ctx, T_out *out, const int64_t &n){
+    /* decode n symbols coded by encode_adaptive, models must start from the same state as the encoder's */
+    for(int64_t i = 0; i < n; i++)
+        out[i] = decoder.decode(*models[ctx ? ctx[i] : 0]);
+}
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "yaecl.hpp"
+using namespace std;
+using namespace yaecl;
+/* usage: yaecl_bench [n] [repeat] > bench.json
+ * sweeps codec (AC, RANGE, RANS) x T_in / T_out x precision (h_precision / t_precision for rans)
+ * x cdf_bits x alphabet size x distribution (uniform, skewed) x mode (1x1, nx1, nxn) and prints
+ * one JSON object with a result per case:
+ * * enc_msym_s / dec_msym_s: million symbols per second, best of repeat runs
+ * * enc_mb_s / dec_mb_s: coded MB (1e6 bytes) per second
+ * * bits_per_sym: coded bits per symbol, ideal_bits_per_sym: -log2(pmf) of the coded symbols
+ * * overhead: bits / ideal bits - 1
+ * modes follow the python wrappers:
+ * * 1x1: one cdf, one encode / decode call per symbol with the raw cdf
+ * * nx1: one cdf, prepared once per batch as RANSEncTable (rans encode) and CDFTable (decode)
+ * * nxn: a cdf per symbol, nxn batches are capped so that the cdfs take at most 64 MB
+ */
+struct BenchData {
+    vector<uint32_t> sym;
+    vector<uint32_t> cdf;
+    int64_t cdf_stride;
+    double ideal_bits;
+};
+vector<uint32_t> quantize(const vector<double> &pmf, const int &cdf_bits){
+    /* cdf with every bin >= 1, the remainder goes to the largest bin */
+    const int64_t total = static_cast<int64_t>(1) << cdf_bits;
+    vector<int64_t> freq(pmf.size());
+    int64_t sum = 0;
+    size_t max_bin = 0;
+    for(size_t i = 0; i < pmf.size(); i++){
+        freq[i] = 1 + static_cast<int64_t>(pmf[i] * (total - static_cast<int64_t>(pmf.size())));
+        sum += freq[i];
+        if(pmf[i] > pmf[max_bin]) max_bin = i;
+    }
+    freq[max_bin] += total - sum;
+    vector<uint32_t> cdf(pmf.size() + 1, 0);
+    for(size_t i = 0; i < pmf.size(); i++) cdf[i + 1] = cdf[i] + static_cast<uint32_t>(freq[i]);
+    return cdf;
+}
+BenchData make_data(const int64_t &n, const int &sym_cnt, const int &cdf_bits, const bool &skewed, const bool &per_symbol, const uint64_t &seed){
+    /* per_symbol picks one of 16 distributions for each symbol and stores a cdf per symbol */
+    const int variants = per_symbol ? 16 : 1;
+    vector<vector<uint32_t>> cdfs(variants);
+    for(int v = 0; v < variants; v++){
+        vector<double> pmf(sym_cnt, 1.0 / sym_cnt);
+        if(skewed){
+            double s = (sym_cnt / 16.0 + 0.5) * (1.0 + v / 8.0), z = 0;
+            for(int i = 0; i < sym_cnt; i++) z += (pmf[i] = exp(-i / s));
+            for(int i = 0; i < sym_cnt; i++) pmf[i] /= z;
+        }
+        cdfs[v] = quantize(pmf, cdf_bits);
+    }
+    BenchData data;
+    data.cdf_stride = per_symbol ? sym_cnt + 1 : 0;
+    data.cdf.resize(per_symbol ? n * (sym_cnt + 1) : sym_cnt + 1);
+    data.sym.resize(n);
+    data.ideal_bits = 0;
+    mt19937_64 rng(seed);
+    for(int64_t i = 0; i < n; i++){
+        const vector<uint32_t> &c = cdfs[per_symbol ? rng() % variants : 0];
+        if(per_symbol || i == 0) copy(c.begin(), c.end(), data.cdf.begin() + i * data.cdf_stride);
+        uint32_t value = static_cast<uint32_t>(rng() & ((static_cast<uint64_t>(1) << cdf_bits) - 1));
+        uint32_t sym = static_cast<uint32_t>(upper_bound(c.begin(), c.end(), value) - c.begin() - 1);
+        data.sym[i] = sym;
+        data.ideal_bits += cdf_bits - log2(static_cast<double>(c[sym + 1] - c[sym]));
+    }
+    return data;
+}
+void check(const bool &ok){
+    /* decode mismatch fails the benchmark, independent of NDEBUG */
+    if(!ok){
+        fprintf(stderr, "[bench] decode mismatch\n");
+        exit(1);
+    }
+}
+template <typename F>
+double best_seconds(const int &repeat, F fn){
+    double best = 1e30;
+    for(int r = 0; r < repeat; r++){
+        auto t0 = chrono::steady_clock::now();
+        fn();
+        auto t1 = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+struct BenchResult {
+    double enc_seconds;
+    double dec_seconds;
+    int64_t bits;
+};
+template <typename T_encoder, typename T_decoder, typename T_out>
+BenchResult bench_stream(const int &precision, const int &mode, const int &sym_cnt, const int &cdf_bits,
+                         const vector<T_out> &sym, const vector<T_out> &cdf, const int64_t &cdf_stride, const int &repeat){
+    /* ac and range coder, mode: 0 = 1x1, 1 = nx1, 2 = nxn */
+    const int64_t n = sym.size();
+    BitStream coded;
+    BenchResult result;
+    result.enc_seconds = best_seconds(repeat, [&](){
+        T_encoder encoder(precision);
+        for(int64_t i = 0; i < n; i++) encoder.encode(sym[i], cdf.data() + i * cdf_stride, cdf_bits);
+        encoder.flush();
+        coded = std::move(encoder.bit_stream);
+    });
+    result.bits = coded.size();
+    vector<T_out> out(n);
+    result.dec_seconds = best_seconds(repeat, [&](){
+        T_decoder decoder(precision, BitStream::view(coded.data(), coded.byte_size()));
+        if(mode == 1){
+            CDFTable<T_out> table(sym_cnt, cdf.data(), cdf_bits);
+            for(int64_t i = 0; i < n; i++) out[i] = decoder.decode(table);
+        }
+        else{
+            for(int64_t i = 0; i < n; i++) out[i] = decoder.decode(sym_cnt, cdf.data() + i * cdf_stride, cdf_bits);
+        }
+    });
+    check(out == sym);
+    return result;
+}
+template <typename T_in, typename T_out>
+BenchResult bench_rans(const int &h_precision, const int &t_precision, const int &mode, const int &sym_cnt, const int &cdf_bits,
+                       const vector<T_out> &sym, const vector<T_out> &cdf, const int64_t &cdf_stride, const int &repeat){
+    /* rans encodes forward and decodes backward, mode: See bench_stream */
+    const int64_t n = sym.size();
+    BitStream coded;
+    BenchResult result;
+    result.enc_seconds = best_seconds(repeat, [&](){
+        RANSCodec<T_in, T_out> codec(h_precision, t_precision);
+        if(mode == 1){
+            RANSEncTable<T_in, T_out> table(sym_cnt, cdf.data(), cdf_bits, h_precision);
+            for(int64_t i = 0; i < n; i++) codec.encode(sym[i], table);
+        }
+        else{
+            for(int64_t i = 0; i < n; i++) codec.encode(sym[i], cdf.data() + i * cdf_stride, cdf_bits);
+        }
+        codec.flush();
+        coded = std::move(codec.bit_stream);
+    });
+    result.bits = coded.size();
+    vector<T_out> out(n);
+    result.dec_seconds = best_seconds(repeat, [&](){
+        RANSCodec<T_in, T_out> codec(h_precision, t_precision, BitStream::view(coded.data(), coded.byte_size()));
+        if(mode == 1){
+            CDFTable<T_out> table(sym_cnt, cdf.data(), cdf_bits);
+            for(int64_t i = n - 1; i >= 0; i--) out[i] = codec.decode(table);
+        }
+        else{
+            for(int64_t i = n - 1; i >= 0; i--) out[i] = codec.decode(sym_cnt, cdf.data() + i * cdf_stride, cdf_bits);
+        }
+    });
+    check(out == sym);
+    return result;
+}
+struct BenchConfig {
+    const char *codec;
+    const char *types;
+    int precision;
+    int t_precision;
+    int cdf_bits[2];
+};
+template <typename T_out>
+BenchResult run(const BenchConfig &config, const int &mode, const int &sym_cnt, const int &cdf_bits, const BenchData &data, const int &repeat){
+    vector<T_out> sym(data.sym.begin(), data.sym.end());
+    vector<T_out> cdf(data.cdf.begin(), data.cdf.end());
+    const string codec = config.codec, types = config.types;
+    if(codec == "AC" && types == "u64/u32")
+        return bench_stream<ArithmeticCodingEncoder<uint64_t, T_out>, ArithmeticCodingDecoder<uint64_t, T_out>>(config.precision, mode, sym_cnt, cdf_bits, sym, cdf, data.cdf_stride, repeat);
+    if(codec == "AC" && types == "u32/u16")
+        return bench_stream<ArithmeticCodingEncoder<uint32_t, T_out>, ArithmeticCodingDecoder<uint32_t, T_out>>(config.precision, mode, sym_cnt, cdf_bits, sym, cdf, data.cdf_stride, repeat);
+    if(codec == "RANGE")
+        return bench_stream<RangeCodingEncoder<uint64_t, T_out>, RangeCodingDecoder<uint64_t, T_out>>(config.precision, mode, sym_cnt, cdf_bits, sym, cdf, data.cdf_stride, repeat);
+    if(types == "u64/u32")
+        return bench_rans<uint64_t, T_out>(config.precision, config.t_precision, mode, sym_cnt, cdf_bits, sym, cdf, data.cdf_stride, repeat);
+    return bench_rans<uint32_t, T_out>(config.precision, config.t_precision, mode, sym_cnt, cdf_bits, sym, cdf, data.cdf_stride, repeat);
+}
+bool parse_count(const char *arg, const long long &max, long long &value){
+    /* whole argument as a decimal count in [1, max] */
+    char *end = nullptr;
+    errno = 0;
+    value = strtoll(arg, &end, 10);
+    return errno == 0 && end != arg && *end == '\0' && value >= 1 && value <= max;
+}
+int main(int argc, char **argv){
+    long long n_arg = 1 << 18, repeat_arg = 3;
+    if(argc > 3 || (argc > 1 && !parse_count(argv[1], std::numeric_limits<int64_t>::max(), n_arg)) ||
+       (argc > 2 && !parse_count(argv[2], std::numeric_limits<int>::max(), repeat_arg))){
+        fprintf(stderr, "usage: %s [n] [repeat] > bench.json\n  n: symbols per case, >= 1\n  repeat: runs per case, >= 1\n", argv[0]);
+        return 1;
+    }
+    const int64_t n = n_arg;
+    const int repeat = static_cast<int>(repeat_arg);
+    const BenchConfig configs[] = {
+        {"AC", "u64/u32", 32, 0, {12, 16}},
+        {"AC", "u64/u32", 48, 0, {12, 14}},
+        {"AC", "u32/u16", 16, 0, {10, 13}},
+        {"RANGE", "u64/u32", 32, 0, {12, 16}},
+        {"RANGE", "u64/u32", 48, 0, {12, 16}},
+        {"RANS", "u64/u32", 64, 32, {12, 16}},
+        {"RANS", "u32/u16", 32, 16, {12, 14}},
+    };
+    const int sym_cnts[] = {2, 16, 256};
+    const char *modes[] = {"1x1", "nx1", "nxn"};
+    printf("{\n  \"n\": %lld,\n  \"repeat\": %d,\n  \"results\": [", static_cast<long long>(n), repeat);
+    bool first = true;
+    for(const BenchConfig &config : configs){
+        for(const int &cdf_bits : config.cdf_bits){
+            for(const int &sym_cnt : sym_cnts){
+                for(int skewed = 0; skewed <= 1; skewed++){
+                    for(int mode = 0; mode < 3; mode++){
+                        int64_t cases = mode == 2 ? min<int64_t>(n, (int64_t(64) << 20) / (4 * (sym_cnt + 1))) : n;
+                        BenchData data = make_data(cases, sym_cnt, cdf_bits, skewed, mode == 2, 1234 + sym_cnt);
+                        BenchResult r = string(config.types) == "u32/u16" ? run<uint16_t>(config, mode, sym_cnt, cdf_bits, data, repeat)
+                                                                         : run<uint32_t>(config, mode, sym_cnt, cdf_bits, data, repeat);
+                        double bytes = r.bits / 8.0;
+                        printf("%s\n    {\"codec\": \"%s\", \"types\": \"%s\", \"precision\": %d, \"t_precision\": %d, \"cdf_bits\": %d, "
+                               "\"sym_cnt\": %d, \"dist\": \"%s\", \"mode\": \"%s\", \"n\": %lld, "
+                               "\"enc_msym_s\": %.3f, \"dec_msym_s\": %.3f, \"enc_mb_s\": %.3f, \"dec_mb_s\": %.3f, "
+                               "\"bits_per_sym\": %.5f, \"ideal_bits_per_sym\": %.5f, \"overhead\": %.6f}",
+                               first ? "" : ",", config.codec, config.types, config.precision, config.t_precision, cdf_bits,
+                               sym_cnt, skewed ? "skewed" : "uniform", modes[mode], static_cast<long long>(cases),
+                               cases / r.enc_seconds / 1e6, cases / r.dec_seconds / 1e6, bytes / r.enc_seconds / 1e6, bytes / r.dec_seconds / 1e6,
+                               static_cast<double>(r.bits) / cases, data.ideal_bits / cases, r.bits / data.ideal_bits - 1);
+                        fflush(stdout);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
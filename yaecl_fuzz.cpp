@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "yaecl.hpp"
+using namespace std;
+using namespace yaecl;
+/* usage: yaecl_fuzz [trials] [seed]
+ * randomized differential round trips: every trial draws a codec instantiation (T_in / T_out of
+ * ArithmeticCodingEncoder / Decoder, RangeCodingEncoder / Decoder and RANSCodec, __uint128_t T_in
+ * where the compiler has it), a precision (h_precision / t_precision for rans) and a cdf_bits inside
+ * the limits of the codec, an alphabet size, random cdfs (one shared or one per symbol) and symbols
+ * drawn from them. each trial checks that decoding gives back the symbols and that the compressed
+ * size stays within the precision bound of the ideal size (sum of -log2 pmf), See check_size.
+ * a failure prints the trial and its parameters and exits 1, independent of NDEBUG.
+ * when NDEBUG is defined, the trials also decode random bytes with fuzz_decode.
+ *
+ * with -DYAECL_LIBFUZZER (cmake -DYAECL_BUILD_FUZZER=ON, clang) this is a libFuzzer target instead:
+ * LLVMFuzzerTestOneInput decodes the input as the stream of one of the decoders or as the index of
+ * a StreamContainer, See fuzz_decode.
+ * the codecs assert invariants of well formed streams, so the target is built with NDEBUG and
+ * only memory errors, undefined behavior and hangs are findings
+ */
+#if defined(__SIZEOF_INT128__) && !defined(__STRICT_ANSI__)
+#define YAECL_FUZZ_U128
+#endif
+template <typename T_out>
+struct FuzzCase {
+    int sym_cnt;
+    int cdf_bits;
+    int64_t cdf_stride;
+    vector<T_out> cdf;
+    vector<T_out> sym;
+    double ideal_bits;
+};
+template <typename T_out, typename T_rng>
+vector<T_out> random_cdf(T_rng &rng, const int &sym_cnt, const int &cdf_bits){
+    /* cdf with every bin >= 1, from uniform to one bin taking almost all of the mass */
+    const uint64_t total = static_cast<uint64_t>(1) << cdf_bits;
+    const double skew = (rng() % 4 == 0) ? 0 : exp(static_cast<double>(rng() % 1000) / 100.0 - 2);
+    vector<double> w(sym_cnt);
+    double z = 0;
+    for(int i = 0; i < sym_cnt; i++)
+        z += (w[i] = exp(-skew * static_cast<double>(rng() % 1024) / 1024.0) * (1 + rng() % 4));
+    vector<uint64_t> freq(sym_cnt);
+    uint64_t sum = 0;
+    int max_bin = 0;
+    for(int i = 0; i < sym_cnt; i++){
+        freq[i] = 1 + static_cast<uint64_t>(w[i] / z * static_cast<double>(total - sym_cnt));
+        freq[i] = min(freq[i], total - sym_cnt + 1);
+        sum += freq[i];
+        if(freq[i] > freq[max_bin]) max_bin = i;
+    }
+    while(sum > total){
+        /* rounding of large totals can overshoot, take it back from the largest bins */
+        for(int i = 0; i < sym_cnt && sum > total; i++){
+            uint64_t d = min(freq[i] - 1, sum - total);
+            freq[i] -= d;
+            sum -= d;
+        }
+    }
+    freq[max_bin] += total - sum;
+    vector<T_out> cdf(sym_cnt + 1, 0);
+    for(int i = 0; i < sym_cnt; i++) cdf[i + 1] = static_cast<T_out>(cdf[i] + freq[i]);
+    return cdf;
+}
+template <typename T_out, typename T_rng>
+FuzzCase<T_out> random_case(T_rng &rng, const int &cdf_bits){
+    /* up to 4096 symbols of an alphabet of up to 300, with one cdf or one of 4 cdfs per symbol */
+    FuzzCase<T_out> c;
+    c.cdf_bits = cdf_bits;
+    c.sym_cnt = 2 + static_cast<int>(rng() % static_cast<uint64_t>(min<int64_t>(299, (static_cast<int64_t>(1) << min(cdf_bits, 20)) - 1)));
+    const bool per_symbol = rng() % 2;
+    const int64_t n = 1 + rng() % 4096;
+    vector<vector<T_out> > cdfs(per_symbol ? 4 : 1);
+    for(auto &cdf : cdfs) cdf = random_cdf<T_out>(rng, c.sym_cnt, cdf_bits);
+    c.cdf_stride = per_symbol ? c.sym_cnt + 1 : 0;
+    c.cdf.resize(per_symbol ? n * (c.sym_cnt + 1) : c.sym_cnt + 1);
+    c.sym.resize(n);
+    c.ideal_bits = 0;
+    for(int64_t i = 0; i < n; i++){
+        const vector<T_out> &cdf = cdfs[rng() % cdfs.size()];
+        if(per_symbol || i == 0) copy(cdf.begin(), cdf.end(), c.cdf.begin() + i * c.cdf_stride);
+        T_out value = static_cast<T_out>(rng() & ((static_cast<uint64_t>(1) << cdf_bits) - 1));
+        T_out sym = static_cast<T_out>(upper_bound(cdf.begin(), cdf.end(), value) - cdf.begin() - 1);
+        c.sym[i] = sym;
+        c.ideal_bits += cdf_bits - log2(static_cast<double>(cdf[sym + 1] - cdf[sym]));
+    }
+    return c;
+}
+struct Trial {
+    /* what a failing trial prints */
+    int index;
+    string codec;
+    int precision;
+    int t_precision;
+    int cdf_bits;
+    int sym_cnt;
+    int64_t n;
+};
+void fail(const Trial &t, const char *what){
+    fprintf(stderr, "[fuzz] trial %d %s precision %d t_precision %d cdf_bits %d sym_cnt %d n %lld: %s\n", t.index, t.codec.c_str(),
+            t.precision, t.t_precision, t.cdf_bits, t.sym_cnt, static_cast<long long>(t.n), what);
+    exit(1);
+}
+template <typename T_out, typename F>
+void check_size(const Trial &t, const FuzzCase<T_out> &c, const int64_t &bits, const double &fixed_bits, F loss){
+    /* bits <= ideal bits + sum of loss(freq) over the symbols + fixed_bits, loss(freq) bounds the
+     * bits one symbol of frequency freq can lose to the finite precision of the codec
+     */
+    double bound = c.ideal_bits + fixed_bits;
+    for(size_t i = 0; i < c.sym.size(); i++){
+        const T_out *cdf = c.cdf.data() + i * c.cdf_stride;
+        bound += loss(static_cast<double>(cdf[c.sym[i] + 1] - cdf[c.sym[i]]));
+    }
+    if(static_cast<double>(bits) > bound){
+        fprintf(stderr, "[fuzz] %lld bits, ideal %.1f, bound %.1f\n", static_cast<long long>(bits), c.ideal_bits, bound);
+        fail(t, "compressed size above the entropy bound");
+    }
+}
+template <typename T_in, typename T_out, typename T_rng>
+void trial_ac(T_rng &rng, Trial t){
+    /* encoder: cdf_bits <= min(precision - 2, digits - precision) - 1, decoder: cdf_bits <= digits - precision - 2 */
+    const int digits = numeric_limits<T_in>::digits;
+    const int precision = 4 + static_cast<int>(rng() % (digits - 6));
+    const int max_bits = min(min(precision - 3, digits - precision - 2), numeric_limits<T_out>::digits - 1);
+    const int cdf_bits = 1 + static_cast<int>(rng() % max_bits);
+    FuzzCase<T_out> c = random_case<T_out>(rng, cdf_bits);
+    t.precision = precision;
+    t.cdf_bits = cdf_bits;
+    t.sym_cnt = c.sym_cnt;
+    t.n = c.sym.size();
+    ArithmeticCodingEncoder<T_in, T_out> encoder(precision);
+    for(size_t i = 0; i < c.sym.size(); i++) encoder.encode(c.sym[i], c.cdf.data() + i * c.cdf_stride, cdf_bits);
+    encoder.flush();
+    ArithmeticCodingDecoder<T_in, T_out> decoder(precision, encoder.bit_stream);
+    const bool table = c.cdf_stride == 0 && rng() % 2;
+    CDFTable<T_out> cdf_table(c.sym_cnt, c.cdf.data(), cdf_bits);
+    for(size_t i = 0; i < c.sym.size(); i++){
+        T_out sym = table ? decoder.decode(cdf_table) : decoder.decode(c.sym_cnt, c.cdf.data() + i * c.cdf_stride, cdf_bits);
+        if(sym != c.sym[i]) fail(t, table ? "decode mismatch (CDFTable)" : "decode mismatch");
+    }
+    /* the coding range never drops below a quarter of 2 ** precision */
+    const double rel = ldexp(1.0, cdf_bits + 2 - precision);
+    check_size(t, c, encoder.bit_stream.size(), 2.0 * precision + 16, [rel](const double &freq){ return 2 * rel / freq; });
+}
+template <typename T_in, typename T_out, typename T_rng>
+void trial_range(T_rng &rng, Trial t){
+    /* precision % 8 == 0, 24 <= precision < digits - 8, cdf_bits <= precision - 16 */
+    const int digits = numeric_limits<T_in>::digits;
+    const int precision = 24 + 8 * static_cast<int>(rng() % ((digits - 9 - 24) / 8 + 1));
+    const int max_bits = min(precision - 16, numeric_limits<T_out>::digits - 1);
+    const int cdf_bits = 1 + static_cast<int>(rng() % max_bits);
+    FuzzCase<T_out> c = random_case<T_out>(rng, cdf_bits);
+    t.precision = precision;
+    t.cdf_bits = cdf_bits;
+    t.sym_cnt = c.sym_cnt;
+    t.n = c.sym.size();
+    RangeCodingEncoder<T_in, T_out> encoder(precision);
+    for(size_t i = 0; i < c.sym.size(); i++) encoder.encode(c.sym[i], c.cdf.data() + i * c.cdf_stride, cdf_bits);
+    encoder.flush();
+    RangeCodingDecoder<T_in, T_out> decoder(precision, encoder.bit_stream);
+    const bool table = c.cdf_stride == 0 && rng() % 2;
+    CDFTable<T_out> cdf_table(c.sym_cnt, c.cdf.data(), cdf_bits);
+    for(size_t i = 0; i < c.sym.size(); i++){
+        T_out sym = table ? decoder.decode(cdf_table) : decoder.decode(c.sym_cnt, c.cdf.data() + i * c.cdf_stride, cdf_bits);
+        if(sym != c.sym[i]) fail(t, table ? "decode mismatch (CDFTable)" : "decode mismatch");
+    }
+    /* the range never drops below 2 ** (precision - 8) */
+    const double rel = ldexp(1.0, cdf_bits + 8 - precision);
+    check_size(t, c, encoder.bit_stream.size(), 2.0 * precision + 16, [rel](const double &){ return 2 * rel; });
+}
+template <typename T_in, typename T_out, typename T_rng>
+void trial_rans(T_rng &rng, Trial t){
+    /* h_precision, t_precision % 8 == 0, t_precision < h_precision <= min(2 * t_precision, digits),
+     * cdf_bits <= h_precision - t_precision
+     */
+    const int digits = numeric_limits<T_in>::digits;
+    const int h_precision = 16 + 8 * static_cast<int>(rng() % ((digits - 16) / 8 + 1));
+    const int t_min = (h_precision / 2 + 7) / 8 * 8;
+    const int t_precision = t_min + 8 * static_cast<int>(rng() % ((h_precision - 8 - t_min) / 8 + 1));
+    const int max_bits = min(h_precision - t_precision, numeric_limits<T_out>::digits - 1);
+    const int cdf_bits = 1 + static_cast<int>(rng() % max_bits);
+    FuzzCase<T_out> c = random_case<T_out>(rng, cdf_bits);
+    t.precision = h_precision;
+    t.t_precision = t_precision;
+    t.cdf_bits = cdf_bits;
+    t.sym_cnt = c.sym_cnt;
+    t.n = c.sym.size();
+    RANSCodec<T_in, T_out> encoder(h_precision, t_precision);
+    const bool table = c.cdf_stride == 0 && rng() % 2;
+    RANSEncTable<T_in, T_out> enc_table(c.sym_cnt, c.cdf.data(), cdf_bits, h_precision);
+    for(size_t i = 0; i < c.sym.size(); i++){
+        if(table) encoder.encode(c.sym[i], enc_table);
+        else encoder.encode(c.sym[i], c.cdf.data() + i * c.cdf_stride, cdf_bits);
+    }
+    encoder.flush();
+    RANSCodec<T_in, T_out> decoder(h_precision, t_precision, encoder.bit_stream);
+    CDFTable<T_out> cdf_table(c.sym_cnt, c.cdf.data(), cdf_bits);
+    for(int64_t i = static_cast<int64_t>(c.sym.size()) - 1; i >= 0; i--){
+        T_out sym = table ? decoder.decode(cdf_table) : decoder.decode(c.sym_cnt, c.cdf.data() + i * c.cdf_stride, cdf_bits);
+        if(sym != c.sym[i]) fail(t, table ? "decode mismatch (RANSEncTable / CDFTable)" : "decode mismatch");
+    }
+    /* a state of x >= freq * 2 ** (h_precision - cdf_bits - t_precision) grows by at most the factor
+     * 1 + freq / x over the ideal, the initial and the flushed state cost h_precision bits each
+     */
+    const double loss = log2(1 + ldexp(1.0, cdf_bits + t_precision - h_precision));
+    check_size(t, c, encoder.bit_stream.size(), 2.0 * h_precision + 16, [loss](const double &){ return loss; });
+}
+template <typename T_out>
+void fuzz_cdf(const uint8_t &seed, const int &sym_cnt, const int &cdf_bits, T_out *cdf){
+    /* a valid cdf picked by one byte of the input, so the fuzzer explores skewed and flat ones */
+    mt19937_64 rng(seed);
+    vector<T_out> c = random_cdf<T_out>(rng, sym_cnt, cdf_bits);
+    copy(c.begin(), c.end(), cdf);
+}
+void fuzz_decode(const uint8_t *data, const size_t &size){
+    /* decode data as the stream of one decoder, which must return without crashing or hanging
+     * data[0]: decoder, data[1]: alphabet size, data[2]: cdf_bits, data[3]: cdf, the rest: the stream
+     * a corrupt container index has to throw std::runtime_error
+     */
+    if(size < 4) return;
+    const int sym_cnt = 2 + data[1] % 63;
+    const int cdf_bits = 6 + data[2] % 11;
+    uint32_t cdf[66];
+    fuzz_cdf(data[3], sym_cnt, cdf_bits, cdf);
+    BitStream stream = BitStream::view(data + 4, size - 4);
+    const int64_t n = 256;
+    vector<uint32_t> out(n, 0);
+    vector<uint32_t> escaped(n);
+    switch(data[0] % 9){
+        case 0: {
+            ArithmeticCodingDecoder<uint64_t, uint32_t> decoder(32, stream);
+            for(int64_t i = 0; i < n; i++) out[i] = decoder.decode(sym_cnt, cdf, cdf_bits);
+            break;
+        }
+        case 1: {
+            ArithmeticCodingDecoder<uint64_t, uint32_t> decoder(32, stream);
+            CDFTable<uint32_t> table(sym_cnt, cdf, cdf_bits);
+            for(int64_t i = 0; i < n; i++) escaped[i] = decode_escape(decoder, sym_cnt, cdf, cdf_bits);
+            for(int64_t i = 0; i < n; i++) out[i] = decoder.decode(table);
+            break;
+        }
+        case 2: {
+            RangeCodingDecoder<uint64_t, uint32_t> decoder(32, stream);
+            for(int64_t i = 0; i < n; i++) out[i] = decoder.decode(sym_cnt, cdf, cdf_bits);
+            break;
+        }
+        case 3: {
+            RANSCodec<uint64_t, uint32_t> decoder(64, 32, stream);
+            for(int64_t i = 0; i < n; i++) out[i] = decoder.decode(sym_cnt, cdf, cdf_bits);
+            break;
+        }
+        case 4: {
+            RANSCodec<uint32_t, uint32_t> decoder(32, 16, stream);
+            for(int64_t i = 0; i < n; i++) escaped[i] = decode_escape(decoder, sym_cnt, cdf, cdf_bits);
+            break;
+        }
+        case 5: {
+            InterleavedRANSCodec<uint64_t, uint32_t, 4> decoder(64, 32, stream);
+            decoder.decode_n(out.data(), n, sym_cnt, cdf, 0, cdf_bits);
+            break;
+        }
+        case 6: {
+            /* tans tables go up to cdf_bits 20 */
+            const int tans_bits = 6 + data[2] % 15;
+            uint32_t tans_cdf[66];
+            fuzz_cdf(data[3], sym_cnt, tans_bits, tans_cdf);
+            TANSDecoder<uint32_t> decoder(stream);
+            decoder.decode_nx1(out.data(), n, sym_cnt, tans_cdf, tans_bits);
+            break;
+        }
+        case 7: {
+            /* the magic and version are prepended, so the index itself is fuzzed */
+            vector<uint8_t> bytes = {'Y', 'A', 'E', 'C', static_cast<uint8_t>(StreamContainer::version)};
+            bytes.insert(bytes.end(), data + 4, data + size);
+            try{
+                StreamContainer container(BitStream::view(bytes.data(), bytes.size()));
+                /* the first and last byte of every substream have to be inside the input */
+                for(int k = 0; k < container.size(); k++){
+                    BitStream sub = container.substream(k);
+                    const uint8_t *p = sub.data();
+                    const int64_t len = sub.byte_size();
+                    if(len > 0) escaped[k % n] += p[0] + p[len - 1];
+                }
+            }catch(const std::runtime_error &){
+            }
+            break;
+        }
+        default: {
+            RangeCodingDecoder<uint64_t, uint32_t> decoder(48, stream);
+            for(int64_t i = 0; i < n; i++) escaped[i] = decode_escape(decoder, sym_cnt, cdf, cdf_bits);
+            break;
+        }
+    }
+    /* whatever the stream, a decoded bin is inside the alphabet */
+    for(int64_t i = 0; i < n; i++)
+        if(out[i] >= static_cast<uint32_t>(sym_cnt)) abort();
+}
+#ifdef YAECL_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+    fuzz_decode(data, size);
+    return 0;
+}
+#else
+int main(int argc, char **argv){
+    const int trials = argc > 1 ? atoi(argv[1]) : 300;
+    const uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1;
+    mt19937_64 rng(seed);
+    const char *codecs[] = {"AC u32/u16", "AC u64/u32", "AC u64/u64", "RANGE u64/u32", "RANS u32/u16", "RANS u64/u32", "RANS u64/u64",
+                            "AC u128/u64", "RANGE u128/u64", "RANS u128/u64"};
+#ifdef YAECL_FUZZ_U128
+    const int codec_cnt = 10;
+#else
+    const int codec_cnt = 7;
+#endif
+    printf("[fuzz] %d round trip trials, seed %llu\n", trials, static_cast<unsigned long long>(seed));
+    for(int k = 0; k < trials; k++){
+        Trial t = {k, codecs[k % codec_cnt], 0, 0, 0, 0, 0};
+        switch(k % codec_cnt){
+            case 0: trial_ac<uint32_t, uint16_t>(rng, t); break;
+            case 1: trial_ac<uint64_t, uint32_t>(rng, t); break;
+            case 2: trial_ac<uint64_t, uint64_t>(rng, t); break;
+            case 3: trial_range<uint64_t, uint32_t>(rng, t); break;
+            case 4: trial_rans<uint32_t, uint16_t>(rng, t); break;
+            case 5: trial_rans<uint64_t, uint32_t>(rng, t); break;
+            case 6: trial_rans<uint64_t, uint64_t>(rng, t); break;
+#ifdef YAECL_FUZZ_U128
+            case 7: trial_ac<__uint128_t, uint64_t>(rng, t); break;
+            case 8: trial_range<__uint128_t, uint64_t>(rng, t); break;
+            case 9: trial_rans<__uint128_t, uint64_t>(rng, t); break;
+#endif
+        }
+    }
+    printf("[fuzz] -- round trip success\n");
+#ifdef NDEBUG
+    /* random streams, the asserts of the codecs would stop at the first one otherwise */
+    for(int k = 0; k < trials; k++){
+        vector<uint8_t> data(4 + rng() % 512);
+        for(auto &b : data) b = static_cast<uint8_t>(rng());
+        fuzz_decode(data.data(), data.size());
+    }
+    printf("[fuzz] -- random stream decoding success\n");
+#endif
+    return 0;
+}
+#endif
@@ -1,9 +1,436 @@
+#include <memory>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include "yaecl.hpp"
 
 using namespace yaecl;
 using namespace pybind11;
 
+template <typename T_encoder, typename T_out>
+/* template args: see encode_param */
+void py_encode_param(T_encoder &encoder, const ParametricCDFBank<T_out> &bank, const buffer &value_buf, const buffer &mean_buf, const buffer &scale_buf){
+    /* value_buf, mean_buf, scale_buf:
+     * * 1D memoryview of float32 or float64 arrays of the same dtype
+     * * * dim 1 = N (value to encode)
+     */
+    buffer_info value_info = value_buf.request();
+    buffer_info mean_info = mean_buf.request();
+    buffer_info scale_info = scale_buf.request();
+    gil_scoped_release release;
+    assert(static_cast<int>(value_info.ndim) == 1 && static_cast<int>(mean_info.ndim) == 1 && static_cast<int>(scale_info.ndim) == 1);
+    assert(value_info.shape[0] == mean_info.shape[0] && value_info.shape[0] == scale_info.shape[0]);
+    assert(value_info.format == mean_info.format && value_info.format == scale_info.format);
+    if(value_info.format == format_descriptor<float>::format()){
+        encode_param(encoder, bank, reinterpret_cast<float*>(value_info.ptr), reinterpret_cast<float*>(mean_info.ptr),
+                     reinterpret_cast<float*>(scale_info.ptr), value_info.shape[0]);
+    } else {
+        assert(value_info.format == format_descriptor<double>::format());
+        encode_param(encoder, bank, reinterpret_cast<double*>(value_info.ptr), reinterpret_cast<double*>(mean_info.ptr),
+                     reinterpret_cast<double*>(scale_info.ptr), value_info.shape[0]);
+    }
+}
+template <typename T_decoder, typename T_out>
+/* template args: see decode_param */
+void py_decode_param(T_decoder &decoder, const ParametricCDFBank<T_out> &bank, const buffer &mean_buf, const buffer &scale_buf, const buffer &out_buf){
+    /* out_buf:
+     * * 1D memoryview to hold the decoded values, same dtype as mean_buf
+     * other args: See py_encode_param
+     */
+    buffer_info mean_info = mean_buf.request();
+    buffer_info scale_info = scale_buf.request();
+    buffer_info out_info = out_buf.request(true);
+    gil_scoped_release release;
+    assert(static_cast<int>(out_info.ndim) == 1 && static_cast<int>(mean_info.ndim) == 1 && static_cast<int>(scale_info.ndim) == 1);
+    assert(out_info.shape[0] == mean_info.shape[0] && out_info.shape[0] == scale_info.shape[0]);
+    assert(out_info.format == mean_info.format && out_info.format == scale_info.format);
+    if(out_info.format == format_descriptor<float>::format()){
+        decode_param(decoder, bank, reinterpret_cast<float*>(mean_info.ptr), reinterpret_cast<float*>(scale_info.ptr),
+                     reinterpret_cast<float*>(out_info.ptr), out_info.shape[0]);
+    } else {
+        assert(out_info.format == format_descriptor<double>::format());
+        decode_param(decoder, bank, reinterpret_cast<double*>(mean_info.ptr), reinterpret_cast<double*>(scale_info.ptr),
+                     reinterpret_cast<double*>(out_info.ptr), out_info.shape[0]);
+    }
+}
+template <typename T_encoder, typename T_out>
+/* template args: see encode_adaptive */
+void py_encode_adaptive(T_encoder &encoder, const buffer &sym_buf, const buffer *ctx_buf, AdaptiveCDF<T_out> *const *models){
+    /* sym_buf:
+     * * 1D memoryview of symbol array
+     * ctx_buf:
+     * * 1D memoryview of int32 context array, same length as sym_buf, nullptr for one model
+     */
+    buffer_info sym_info = sym_buf.request();
+    buffer_info ctx_info = ctx_buf ? ctx_buf->request() : buffer_info();
+    gil_scoped_release release;
+    assert(static_cast<int>(sym_info.ndim) == 1);
+    assert(!ctx_buf || (static_cast<int>(ctx_info.ndim) == 1 && ctx_info.shape[0] == sym_info.shape[0] && ctx_info.format == format_descriptor<int32_t>::format()));
+    encode_adaptive(encoder, models, reinterpret_cast<T_out*>(sym_info.ptr), ctx_buf ? reinterpret_cast<int32_t*>(ctx_info.ptr) : nullptr, sym_info.shape[0]);
+}
+template <typename T_decoder, typename T_out>
+/* template args: see decode_adaptive */
+void py_decode_adaptive(T_decoder &decoder, const buffer *ctx_buf, AdaptiveCDF<T_out> *const *models, const buffer &out_buf){
+    /* out_buf:
+     * * 1D memoryview to hold the decoded symbols
+     * other args: See py_encode_adaptive
+     */
+    buffer_info ctx_info = ctx_buf ? ctx_buf->request() : buffer_info();
+    buffer_info out_info = out_buf.request(true);
+    gil_scoped_release release;
+    assert(static_cast<int>(out_info.ndim) == 1);
+    assert(!ctx_buf || (static_cast<int>(ctx_info.ndim) == 1 && ctx_info.shape[0] == out_info.shape[0] && ctx_info.format == format_descriptor<int32_t>::format()));
+    decode_adaptive(decoder, models, ctx_buf ? reinterpret_cast<int32_t*>(ctx_info.ptr) : nullptr, reinterpret_cast<T_out*>(out_info.ptr), out_info.shape[0]);
+}
+template <typename T_out>
+std::vector<AdaptiveCDF<T_out>*> py_adaptive_models(const list &models){
+    /* models:
+     * * list of adaptive_cdf_t, one per context, updated in place
+     */
+    std::vector<AdaptiveCDF<T_out>*> ptrs(models.size());
+    for(size_t k = 0; k < models.size(); k++)
+        ptrs[k] = models[k].cast<AdaptiveCDF<T_out>*>();
+    return ptrs;
+}
+class PYBitModels {
+  /* BitModel per context for the batch bit coding of range_encoder_t / range_decoder_t */
+  public:
+    PYBitModels(const int &count, const int &shift){
+        /* count:
+         * * number of contexts
+         * shift:
+         * * See BitModel
+         */
+        assert(count >= 1);
+        _shift = shift;
+        models.assign(count, BitModel(shift));
+    }
+    ~PYBitModels(){}
+    void reset(){
+        /* back to probability 1 / 2, e.g. before decoding with the models of the encoder */
+        models.assign(models.size(), BitModel(_shift));
+    }
+    std::vector<int> p() const {
+        /* current probability of 0 of each context, in units of 1 / 2 ** BitModel::prob_bits */
+        std::vector<int> p;
+        for(const BitModel &model : models) p.push_back(model.p());
+        return p;
+    }
+    int size() const { return static_cast<int>(models.size()); }
+    std::vector<BitModel> models;
+  private:
+    int _shift;
+};
+void py_check_bits(const buffer_info &bits_info, const buffer_info &other_info, const int &itemsize){
+    /* bits are 1D uint8 (or bool), other_info 1D with itemsize bytes and the same length */
+    assert(static_cast<int>(bits_info.ndim) == 1 && bits_info.itemsize == 1);
+    assert(static_cast<int>(other_info.ndim) == 1 && other_info.itemsize == itemsize && other_info.shape[0] == bits_info.shape[0]);
+}
+template <typename F>
+void py_dispatch_int(const buffer_info &info, const F &fn){
+    /* calls fn(static_cast<T_sym*>(nullptr)), T_sym being the integer dtype of info
+     * * uint8 (or bool), int8, uint16, int16, uint32, int32 or int64
+     * so that each symbol dtype gets its own inner loop instead of a converted copy
+     */
+    const char kind = info.format.empty() ? '?' : info.format[info.format.size() - 1];
+    assert(std::string("?bBhHiIlLqQ").find(kind) != std::string::npos);
+    const bool is_signed = kind == 'b' || kind == 'h' || kind == 'i' || kind == 'l' || kind == 'q';
+    if(info.itemsize == 1){
+        if(is_signed) fn(static_cast<int8_t*>(nullptr));
+        else fn(static_cast<uint8_t*>(nullptr));
+    } else if(info.itemsize == 2){
+        if(is_signed) fn(static_cast<int16_t*>(nullptr));
+        else fn(static_cast<uint16_t*>(nullptr));
+    } else if(info.itemsize == 4){
+        if(is_signed) fn(static_cast<int32_t*>(nullptr));
+        else fn(static_cast<uint32_t*>(nullptr));
+    } else {
+        assert(info.itemsize == 8);
+        fn(static_cast<int64_t*>(nullptr));
+    }
+}
+template <typename T_out, typename F>
+void py_walk_nd(const buffer_info &sym_info, const buffer_info &cdf_info, F fn){
+    /* sym_info:
+     * * N-D symbol array, any strides
+     * cdf_info:
+     * * cdf array of T_out, the last dim is alphabet size + 1 and contiguous
+     * * the leading dims broadcast against the symbol dims as in numpy, e.g.
+     * * * N x (K + 1) for a 1D array of N symbols, one cdf per symbol
+     * * * C x 1 x 1 x (K + 1) for a B x C x H x W array, one cdf per channel
+     * * * (K + 1) for one cdf shared by all symbols
+     * calls fn(symbol address, cdf row) for each symbol in C order
+     */
+    const int nd = static_cast<int>(sym_info.ndim);
+    const int lead = static_cast<int>(cdf_info.ndim) - 1;
+    assert(lead >= 0 && lead <= nd);
+    assert(cdf_info.itemsize == static_cast<ssize_t>(sizeof(T_out)) && cdf_info.strides[lead] == static_cast<ssize_t>(sizeof(T_out)));
+    std::vector<ssize_t> cdf_strides(nd, 0);
+    ssize_t total = 1;
+    for(int d = 0; d < nd; d++){
+        const int k = d - (nd - lead);
+        if(k >= 0 && cdf_info.shape[k] != 1){
+            assert(cdf_info.shape[k] == sym_info.shape[d]);
+            cdf_strides[d] = cdf_info.strides[k];
+        }
+        total *= sym_info.shape[d];
+    }
+    char *sym = reinterpret_cast<char*>(sym_info.ptr);
+    const char *cdf = reinterpret_cast<const char*>(cdf_info.ptr);
+    if(nd == 0){
+        fn(sym, reinterpret_cast<const T_out*>(cdf));
+        return;
+    }
+    const ssize_t inner_cnt = sym_info.shape[nd - 1];
+    const ssize_t sym_inner = sym_info.strides[nd - 1];
+    const ssize_t cdf_inner = cdf_strides[nd - 1];
+    std::vector<ssize_t> idx(nd, 0);
+    ssize_t sym_off = 0, cdf_off = 0;
+    for(ssize_t done = 0; done < total; done += inner_cnt){
+        for(ssize_t i = 0; i < inner_cnt; i++)
+            fn(sym + sym_off + i * sym_inner, reinterpret_cast<const T_out*>(cdf + cdf_off + i * cdf_inner));
+        for(int d = nd - 2; d >= 0; d--){
+            sym_off += sym_info.strides[d];
+            cdf_off += cdf_strides[d];
+            if(++idx[d] < sym_info.shape[d]) break;
+            sym_off -= sym_info.strides[d] * sym_info.shape[d];
+            cdf_off -= cdf_strides[d] * sym_info.shape[d];
+            idx[d] = 0;
+        }
+    }
+}
+template <typename T_out, typename F>
+struct PYEncodeND {
+    /* inner loop of py_encode_nd for one symbol dtype */
+    template <typename T_sym>
+    void operator()(T_sym*) const {
+        F &fn = encode_fn;
+        py_walk_nd<T_out>(sym_info, cdf_info, [&fn](char *sym, const T_out *cdf){
+            fn(static_cast<int64_t>(*reinterpret_cast<T_sym*>(sym)), cdf);
+        });
+    }
+    const buffer_info &sym_info;
+    const buffer_info &cdf_info;
+    F &encode_fn;
+};
+template <typename T_out, typename F>
+struct PYDecodeND {
+    /* inner loop of py_decode_nd for one symbol dtype */
+    template <typename T_sym>
+    void operator()(T_sym*) const {
+        F &fn = decode_fn;
+        py_walk_nd<T_out>(out_info, cdf_info, [&fn](char *out, const T_out *cdf){
+            *reinterpret_cast<T_sym*>(out) = static_cast<T_sym>(fn(cdf));
+        });
+    }
+    const buffer_info &out_info;
+    const buffer_info &cdf_info;
+    F &decode_fn;
+};
+template <typename T_out, typename F>
+void py_encode_nd(const buffer &sym_buf, const buffer &cdf_buf, F encode_fn){
+    /* sym_buf, cdf_buf:
+     * * memoryview of N-D symbol array and its cdf, See py_walk_nd, py_dispatch_int
+     * encode_fn:
+     * * encode_fn(sym, cdf row) codes one symbol, sym is passed as int64_t so that escape coding
+     *   sees the value of any dtype, not the value cast to T_out
+     */
+    buffer_info sym_info = sym_buf.request();
+    buffer_info cdf_info = cdf_buf.request();
+    gil_scoped_release release;
+    PYEncodeND<T_out, F> loop = {sym_info, cdf_info, encode_fn};
+    py_dispatch_int(sym_info, loop);
+}
+template <typename T_out, typename F>
+void py_decode_nd(const buffer &cdf_buf, const buffer &out_buf, F decode_fn){
+    /* out_buf:
+     * * memoryview of N-D array to hold the decoded symbols, any integer dtype and strides
+     * decode_fn:
+     * * decode_fn(cdf row) returns one symbol
+     * other args: See py_encode_nd
+     */
+    buffer_info cdf_info = cdf_buf.request();
+    buffer_info out_info = out_buf.request(true);
+    gil_scoped_release release;
+    PYDecodeND<T_out, F> loop = {out_info, cdf_info, decode_fn};
+    py_dispatch_int(out_info, loop);
+}
+struct PYGather1D {
+    /* copy of a 1D integer array of one dtype, any stride */
+    template <typename T_sym>
+    void operator()(T_sym*) const {
+        const char *ptr = reinterpret_cast<const char*>(info.ptr);
+        for(size_t i = 0; i < values.size(); i++)
+            values[i] = static_cast<int64_t>(*reinterpret_cast<const T_sym*>(ptr + i * info.strides[0]));
+    }
+    const buffer_info &info;
+    std::vector<int64_t> &values;
+};
+struct PYScatter1D {
+    /* writes values to a 1D integer array of one dtype, any stride */
+    template <typename T_sym>
+    void operator()(T_sym*) const {
+        char *ptr = reinterpret_cast<char*>(info.ptr);
+        for(size_t i = 0; i < values.size(); i++)
+            *reinterpret_cast<T_sym*>(ptr + i * info.strides[0]) = static_cast<T_sym>(values[i]);
+    }
+    const buffer_info &info;
+    const std::vector<int64_t> &values;
+};
+std::vector<int64_t> py_gather_1d(const buffer_info &info){
+    /* values of a 1D integer array of any dtype and stride, See py_dispatch_int */
+    if(static_cast<int>(info.ndim) != 1)
+        throw std::invalid_argument("expected a 1D integer array");
+    std::vector<int64_t> values(static_cast<size_t>(info.shape[0]));
+    PYGather1D gather = {info, values};
+    py_dispatch_int(info, gather);
+    return values;
+}
+template <typename T_out>
+std::vector<const T_out*> py_bank_rows(const buffer_info &cdf_info, const std::vector<int64_t> &index){
+    /* cdf row of each index into a 2D cdf bank of T_out, rows contiguous,
+     * an index outside the bank throws std::out_of_range
+     */
+    if(static_cast<int>(cdf_info.ndim) != 2 || cdf_info.itemsize != static_cast<ssize_t>(sizeof(T_out)) ||
+       cdf_info.strides[1] != static_cast<ssize_t>(sizeof(T_out)))
+        throw std::invalid_argument("cdf bank: expected a 2D array of contiguous rows of int32");
+    std::vector<const T_out*> rows(index.size());
+    const char *bank = reinterpret_cast<const char*>(cdf_info.ptr);
+    for(size_t i = 0; i < index.size(); i++){
+        if(index[i] < 0 || index[i] >= cdf_info.shape[0])
+            throw std::out_of_range("cdf bank: row index out of range");
+        rows[i] = reinterpret_cast<const T_out*>(bank + index[i] * cdf_info.strides[0]);
+    }
+    return rows;
+}
+int py_sym_cnt(const buffer &cdf_buf){
+    /* alphabet size of a cdf array, from its last dim */
+    buffer_info cdf_info = cdf_buf.request();
+    assert(cdf_info.ndim >= 1);
+    return static_cast<int>(cdf_info.shape[cdf_info.ndim - 1]) - 1;
+}
+template <typename T_out>
+bool py_is_flat(const buffer_info &sym_info, const buffer_info &cdf_info){
+    /* sym_info is a contiguous 1D T_out array and cdf_info one cdf per symbol or a shared cdf,
+     * the layout of the block coding in InterleavedRANSCodec
+     */
+    return static_cast<int>(sym_info.ndim) == 1 && sym_info.format == format_descriptor<T_out>::format() &&
+           sym_info.strides[0] == static_cast<ssize_t>(sizeof(T_out)) &&
+           (static_cast<int>(cdf_info.ndim) == 1 || (static_cast<int>(cdf_info.ndim) == 2 && cdf_info.shape[0] == sym_info.shape[0])) &&
+           cdf_info.strides[cdf_info.ndim - 1] == static_cast<ssize_t>(sizeof(T_out));
+}
+struct PYGroupOffsets {
+    /* byte offsets of the group symbols of py_walk_group for one position dtype */
+    template <typename T_pos>
+    void operator()(T_pos*) const {
+        const int nd = static_cast<int>(sym_info.ndim);
+        ssize_t total = 1;
+        for(int d = 0; d < nd; d++)
+            total *= sym_info.shape[d];
+        const char *pos = reinterpret_cast<const char*>(pos_info.ptr);
+        for(size_t k = 0; k < offsets.size(); k++){
+            ssize_t flat = static_cast<ssize_t>(*reinterpret_cast<const T_pos*>(pos + k * pos_info.strides[0]));
+            assert(flat >= 0 && flat < total);
+            ssize_t offset = 0;
+            for(int d = nd - 1; d >= 0; d--){
+                offset += (flat % sym_info.shape[d]) * sym_info.strides[d];
+                flat /= sym_info.shape[d];
+            }
+            offsets[k] = offset;
+        }
+    }
+    const buffer_info &sym_info;
+    const buffer_info &pos_info;
+    std::vector<ssize_t> &offsets;
+};
+template <typename T_out, typename F>
+void py_walk_group(const buffer_info &sym_info, const buffer_info &pos_info, const buffer_info &cdf_info, const bool &reverse, F fn){
+    /* sym_info:
+     * * N-D array of all symbols, any strides
+     * pos_info:
+     * * 1D integer array of the flat (C order) indices of a group of G symbols in sym_info,
+     * * e.g. one color of a checkerboard or one diagonal wavefront
+     * cdf_info:
+     * * G x (K + 1) with one cdf per group symbol, or (K + 1) shared, the last dim contiguous
+     * calls fn(symbol address, cdf row) for each group symbol in pos order, or backwards with reverse
+     */
+    assert(static_cast<int>(pos_info.ndim) == 1);
+    const ssize_t group = pos_info.shape[0];
+    assert(cdf_info.itemsize == static_cast<ssize_t>(sizeof(T_out)) && cdf_info.strides[cdf_info.ndim - 1] == static_cast<ssize_t>(sizeof(T_out)));
+    assert(static_cast<int>(cdf_info.ndim) == 1 || (static_cast<int>(cdf_info.ndim) == 2 && cdf_info.shape[0] == group));
+    const ssize_t cdf_stride = cdf_info.ndim == 2 ? cdf_info.strides[0] : 0;
+    std::vector<ssize_t> offsets(group);
+    PYGroupOffsets unravel = {sym_info, pos_info, offsets};
+    py_dispatch_int(pos_info, unravel);
+    char *sym = reinterpret_cast<char*>(sym_info.ptr);
+    const char *cdf = reinterpret_cast<const char*>(cdf_info.ptr);
+    for(ssize_t i = 0; i < group; i++){
+        const ssize_t k = reverse ? group - 1 - i : i;
+        fn(sym + offsets[k], reinterpret_cast<const T_out*>(cdf + k * cdf_stride));
+    }
+}
+template <typename T_out, typename F>
+struct PYEncodeGroup {
+    /* inner loop of py_encode_group for one symbol dtype */
+    template <typename T_sym>
+    void operator()(T_sym*) const {
+        F &fn = encode_fn;
+        py_walk_group<T_out>(sym_info, pos_info, cdf_info, reverse, [&fn](char *sym, const T_out *cdf){
+            fn(static_cast<T_out>(*reinterpret_cast<T_sym*>(sym)), cdf);
+        });
+    }
+    const buffer_info &sym_info;
+    const buffer_info &pos_info;
+    const buffer_info &cdf_info;
+    bool reverse;
+    F &encode_fn;
+};
+template <typename T_out, typename F>
+struct PYDecodeGroup {
+    /* inner loop of py_decode_group for one symbol dtype */
+    template <typename T_sym>
+    void operator()(T_sym*) const {
+        F &fn = decode_fn;
+        py_walk_group<T_out>(out_info, pos_info, cdf_info, false, [&fn](char *out, const T_out *cdf){
+            *reinterpret_cast<T_sym*>(out) = static_cast<T_sym>(fn(cdf));
+        });
+    }
+    const buffer_info &out_info;
+    const buffer_info &pos_info;
+    const buffer_info &cdf_info;
+    F &decode_fn;
+};
+template <typename T_out, typename F>
+void py_encode_group(const buffer &sym_buf, const buffer &pos_buf, const buffer &cdf_buf, const bool &reverse, F encode_fn){
+    /* sym_buf, pos_buf, cdf_buf:
+     * * memoryview of the N-D array of all symbols, the group positions and their cdf, See py_walk_group
+     * reverse:
+     * * code the group backwards, for rans
+     * encode_fn:
+     * * encode_fn(sym, cdf row) codes one symbol
+     */
+    buffer_info sym_info = sym_buf.request();
+    buffer_info pos_info = pos_buf.request();
+    buffer_info cdf_info = cdf_buf.request();
+    gil_scoped_release release;
+    PYEncodeGroup<T_out, F> loop = {sym_info, pos_info, cdf_info, reverse, encode_fn};
+    py_dispatch_int(sym_info, loop);
+}
+template <typename T_out, typename F>
+void py_decode_group(const buffer &pos_buf, const buffer &cdf_buf, const buffer &out_buf, F decode_fn){
+    /* out_buf:
+     * * memoryview of the N-D array of all symbols, the group symbols are written at their positions
+     * * and the rest is left as is, so the context model of the next group reads it directly
+     * decode_fn:
+     * * decode_fn(cdf row) returns one symbol
+     * other args: See py_encode_group
+     */
+    buffer_info pos_info = pos_buf.request();
+    buffer_info cdf_info = cdf_buf.request();
+    buffer_info out_info = out_buf.request(true);
+    gil_scoped_release release;
+    PYDecodeGroup<T_out, F> loop = {out_info, pos_info, cdf_info, decode_fn};
+    py_dispatch_int(out_info, loop);
+}
 template <typename T_in, typename T_out>
 /* template args: see ArithmeticCodingEncoder */
 class PYArithmeticCodingEncoder : public ArithmeticCodingEncoder<T_in, T_out> {
@@ -29,41 +456,70 @@ class PYArithmeticCodingEncoder : public ArithmeticCodingEncoder<T_in, T_out> {
     void encode_nx1(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
         /* args: See ArithmeticCodingEncoder 
          * sym_buf
-         * * 1D memory view of symbol array
-         * * * dim 1 = N (symbol to encode)
+         * * N-D memory view of symbol array, uint8, int8, uint16, int16, int32 or int64, any strides
+         * * * e.g. 1D, dim 1 = N (symbol to encode)
          * cdf_buf:
          * * 1D memoryview of cdf array
          * * * dim 1 = alphabet size + 1
          */
-        buffer_info sym_info = sym_buf.request();
-        buffer_info cdf_info = cdf_buf.request();
-        assert(static_cast<int>(sym_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 1);
-        for(int i = 0; i < sym_info.shape[0]; i++){
-            ArithmeticCodingEncoder<T_in, T_out>::encode((reinterpret_cast<T_out*>(sym_info.ptr))[i],
-                                                          reinterpret_cast<T_out*>(cdf_info.ptr),
-                                                          cdf_bits);
-        }
+        encode_nxn(sym_buf, cdf_buf, cdf_bits, false);
     }
-    void encode_nxn(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
+    void encode_nxn(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits, const bool &escape){
         /* args: See ArithmeticCodingEncoder 
          * sym_buf
-         * * 1D memory view of symbol array
-         * * * dim 1 = N (symbol to encode)
+         * * N-D memory view of symbol array, See encode_nx1
          * cdf_buf:
-         * * 2D memoryview of cdf array
-         * * * dim 1 = N (symbol to encode)
-         * * * dim 2 = alphabet size + 1
+         * * memoryview of cdf array broadcast against sym_buf, See py_walk_nd
+         * * * e.g. 2D, dim 1 = N (symbol to encode), dim 2 = alphabet size + 1
+         * escape:
+         * * the last bin is the escape bin, values outside [0, alphabet size - 1) are coded with it, See encode_escape
+         * * symbols are read as int64, so negative values of a signed dtype and values above int32 escape too
          */
-        buffer_info sym_info = sym_buf.request();
-        buffer_info cdf_info = cdf_buf.request();
-        assert(static_cast<int>(sym_info.ndim == 1) && static_cast<int>(cdf_info.ndim) == 2);
-        assert(static_cast<int>(sym_info.shape[0]) == static_cast<int>(cdf_info.shape[0]));
-        assert(sizeof(T_out) == cdf_info.strides[1]);
-        for(int i = 0; i < sym_info.shape[0]; i++){
-            ArithmeticCodingEncoder<T_in, T_out>::encode((reinterpret_cast<T_out*>(sym_info.ptr))[i],
-                                                          reinterpret_cast<T_out*>(cdf_info.ptr) + i * (cdf_info.strides[0] / cdf_info.strides[1]),
-                                                          cdf_bits);
+        if(escape){
+            ArithmeticCodingEncoder<T_in, T_out> &enc = *this;
+            const int sym_cnt = py_sym_cnt(cdf_buf);
+            py_encode_nd<T_out>(sym_buf, cdf_buf, [&enc, &sym_cnt, &cdf_bits](const int64_t &sym, const T_out *cdf){
+                encode_escape(enc, sym, sym_cnt, cdf, cdf_bits);
+            });
+            return;
         }
+        py_encode_nd<T_out>(sym_buf, cdf_buf, [this, &cdf_bits](const T_out &sym, const T_out *cdf){
+            ArithmeticCodingEncoder<T_in, T_out>::encode(sym, cdf, cdf_bits);
+        });
+    }
+    void encode_group(const buffer &sym_buf, const buffer &pos_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder
+         * sym_buf
+         * * N-D memory view of all symbols, e.g. a B x C x H x W latent
+         * pos_buf
+         * * 1D memory view of the flat indices of one group of symbols into sym_buf
+         * * * e.g. one color of a checkerboard, or one diagonal wavefront
+         * cdf_buf:
+         * * 2D memoryview of the cdf of each group symbol, or 1D shared, See py_walk_group
+         * * * dim 1 = G (symbols in group), dim 2 = alphabet size + 1
+         * call once per group in decoding order, the cdfs may depend on the symbols of earlier groups
+         */
+        py_encode_group<T_out>(sym_buf, pos_buf, cdf_buf, false, [this, &cdf_bits](const T_out &sym, const T_out *cdf){
+            ArithmeticCodingEncoder<T_in, T_out>::encode(sym, cdf, cdf_bits);
+        });
+    }
+    void encode_param(const buffer &value_buf, const buffer &mean_buf, const buffer &scale_buf, const ParametricCDFBank<T_out> &bank){
+        /* args: See py_encode_param, ParametricCDFBank */
+        py_encode_param(static_cast<ArithmeticCodingEncoder<T_in, T_out>&>(*this), bank, value_buf, mean_buf, scale_buf);
+    }
+    void encode_adaptive(const buffer &sym_buf, AdaptiveCDF<T_out> &model){
+        /* args: See py_encode_adaptive, AdaptiveCDF
+         * all symbols are coded with model, which is updated in place
+         */
+        AdaptiveCDF<T_out> *models[1] = {&model};
+        py_encode_adaptive(static_cast<ArithmeticCodingEncoder<T_in, T_out>&>(*this), sym_buf, nullptr, models);
+    }
+    void encode_context(const buffer &sym_buf, const buffer &ctx_buf, const list &models){
+        /* args: See py_encode_adaptive, py_adaptive_models
+         * symbol i is coded with models[ctx[i]]
+         */
+        std::vector<AdaptiveCDF<T_out>*> ptrs = py_adaptive_models<T_out>(models);
+        py_encode_adaptive(static_cast<ArithmeticCodingEncoder<T_in, T_out>&>(*this), sym_buf, &ctx_buf, ptrs.data());
     }
 };
 template <typename T_in, typename T_out>
@@ -89,30 +545,250 @@ class PYArithmeticCodingDecoder : public ArithmeticCodingDecoder<T_in, T_out> {
          * out_buf
          * * 1D memory view of empty array to hold decoded symbols 
          * * * dim 1 = N (symbol to decode)
+         * the cdf is prepared once as a CDFTable
          */
         buffer_info cdf_info = cdf_buf.request();
-        buffer_info out_info = out_buf.request();
-        assert(static_cast<int>(out_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 1);
-        for(int i = 0; i < out_info.shape[0]; i++){
-            reinterpret_cast<T_out*>(out_info.ptr)[i] = ArithmeticCodingDecoder<T_in, T_out>::decode(sym_cnt,
-                                                                                                     reinterpret_cast<T_out*> (cdf_info.ptr),
-                                                                                                     cdf_bits);
-
-        }
+        assert(static_cast<int>(cdf_info.ndim) == 1);
+        CDFTable<T_out> table(sym_cnt, reinterpret_cast<T_out*>(cdf_info.ptr), cdf_bits);
+        py_decode_nd<T_out>(cdf_buf, out_buf, [this, &table](const T_out*){
+            return ArithmeticCodingDecoder<T_in, T_out>::decode(table);
+        });
     }
-    void decode_nxn(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
-        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingEncoder, decode_nx1 */
+    void decode_nxn(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf, const bool &escape){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingEncoder, decode_nx1
+         * with set_table_cache, cdf rows are decoded through a CDFTableCache
+         * escape:
+         * * See PYArithmeticCodingEncoder::encode_nxn, sym_cnt counts the escape bin
+         */
+        ArithmeticCodingDecoder<T_in, T_out> &dec = *this;
+        std::shared_ptr<CDFTableCache<T_out> > cache = _table_cache;
+        py_decode_nd<T_out>(cdf_buf, out_buf, [&dec, &cache, &sym_cnt, &cdf_bits, &escape](const T_out *cdf){
+            T_out sym = cache ? dec.decode(cache->get(sym_cnt, cdf, cdf_bits)) : dec.decode(sym_cnt, cdf, cdf_bits);
+            return escape ? read_escape(dec, static_cast<int64_t>(sym), sym_cnt) : static_cast<int64_t>(sym);
+        });
+    }
+    void decode_group(const int &sym_cnt, const buffer &pos_buf, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingEncoder::encode_group
+         * out_buf
+         * * N-D memory view of all symbols, the group is written at pos_buf and the rest is kept,
+         * * so the context model reads the symbols decoded so far from the same array
+         * one native call per group instead of one per symbol for autoregressive models
+         */
+        py_decode_group<T_out>(pos_buf, cdf_buf, out_buf, [this, &sym_cnt, &cdf_bits](const T_out *cdf){
+            return ArithmeticCodingDecoder<T_in, T_out>::decode(sym_cnt, cdf, cdf_bits);
+        });
+    }
+    void decode_param(const buffer &mean_buf, const buffer &scale_buf, const ParametricCDFBank<T_out> &bank, const buffer &out_buf){
+        /* args: See py_decode_param, ParametricCDFBank */
+        py_decode_param(static_cast<ArithmeticCodingDecoder<T_in, T_out>&>(*this), bank, mean_buf, scale_buf, out_buf);
+    }
+    void decode_adaptive(AdaptiveCDF<T_out> &model, const buffer &out_buf){
+        /* args: See py_decode_adaptive, encode_adaptive */
+        AdaptiveCDF<T_out> *models[1] = {&model};
+        py_decode_adaptive(static_cast<ArithmeticCodingDecoder<T_in, T_out>&>(*this), nullptr, models, out_buf);
+    }
+    void decode_context(const buffer &ctx_buf, const list &models, const buffer &out_buf){
+        /* args: See py_decode_adaptive, encode_context */
+        std::vector<AdaptiveCDF<T_out>*> ptrs = py_adaptive_models<T_out>(models);
+        py_decode_adaptive(static_cast<ArithmeticCodingDecoder<T_in, T_out>&>(*this), &ctx_buf, ptrs.data(), out_buf);
+    }
+    void set_table_cache(const int &capacity){
+        /* capacity:
+         * * number of CDFTable kept for decode_nxn, 0 disables the cache
+         * * worth it when cdf rows repeat, e.g. cdf picked from a small set per channel
+         */
+        if(capacity > 0)
+            _table_cache = std::make_shared<CDFTableCache<T_out> >(capacity);
+        else
+            _table_cache.reset();
+    }
+  private:
+    std::shared_ptr<CDFTableCache<T_out> > _table_cache;
+};
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class PYRangeCodingEncoder : public RangeCodingEncoder<T_in, T_out> {
+  public:
+    PYRangeCodingEncoder(): RangeCodingEncoder<T_in, T_out>(32) {}
+    PYRangeCodingEncoder(const int &precision): RangeCodingEncoder<T_in, T_out>(precision) {
+        /* args: See RangeCodingEncoder */
+    }
+    ~PYRangeCodingEncoder(){}
+    void encode(const int &sym, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder */
         buffer_info cdf_info = cdf_buf.request();
-        buffer_info out_info = out_buf.request();
-        assert(static_cast<int>(out_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 2);
-        assert(static_cast<int>(out_info.shape[0]) == static_cast<int>(cdf_info.shape[0]));
-        for(int i = 0; i < out_info.shape[0]; i++){
-            reinterpret_cast<T_out*>(out_info.ptr)[i] = ArithmeticCodingDecoder<T_in, T_out>::decode(sym_cnt,
-                                                                                                     reinterpret_cast<T_out*> (cdf_info.ptr) + i * (cdf_info.strides[0] / cdf_info.strides[1]),
-                                                                                                     cdf_bits);
-
+        RangeCodingEncoder<T_in, T_out>::encode(sym,
+                                                reinterpret_cast<T_out*> (cdf_info.ptr),
+                                                cdf_bits);
+    }
+    void encode_nx1(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder */
+        encode_nxn(sym_buf, cdf_buf, cdf_bits, false);
+    }
+    void encode_nxn(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits, const bool &escape){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder */
+        if(escape){
+            RangeCodingEncoder<T_in, T_out> &enc = *this;
+            const int sym_cnt = py_sym_cnt(cdf_buf);
+            py_encode_nd<T_out>(sym_buf, cdf_buf, [&enc, &sym_cnt, &cdf_bits](const int64_t &sym, const T_out *cdf){
+                encode_escape(enc, sym, sym_cnt, cdf, cdf_bits);
+            });
+            return;
         }
+        py_encode_nd<T_out>(sym_buf, cdf_buf, [this, &cdf_bits](const T_out &sym, const T_out *cdf){
+            RangeCodingEncoder<T_in, T_out>::encode(sym, cdf, cdf_bits);
+        });
+    }
+    void encode_group(const buffer &sym_buf, const buffer &pos_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See PYArithmeticCodingEncoder::encode_group */
+        py_encode_group<T_out>(sym_buf, pos_buf, cdf_buf, false, [this, &cdf_bits](const T_out &sym, const T_out *cdf){
+            RangeCodingEncoder<T_in, T_out>::encode(sym, cdf, cdf_bits);
+        });
+    }
+    void encode_param(const buffer &value_buf, const buffer &mean_buf, const buffer &scale_buf, const ParametricCDFBank<T_out> &bank){
+        /* args: See py_encode_param, ParametricCDFBank */
+        py_encode_param(static_cast<RangeCodingEncoder<T_in, T_out>&>(*this), bank, value_buf, mean_buf, scale_buf);
+    }
+    void encode_adaptive(const buffer &sym_buf, AdaptiveCDF<T_out> &model){
+        /* args: See py_encode_adaptive, AdaptiveCDF
+         * all symbols are coded with model, which is updated in place
+         */
+        AdaptiveCDF<T_out> *models[1] = {&model};
+        py_encode_adaptive(static_cast<RangeCodingEncoder<T_in, T_out>&>(*this), sym_buf, nullptr, models);
+    }
+    void encode_context(const buffer &sym_buf, const buffer &ctx_buf, const list &models){
+        /* args: See py_encode_adaptive, py_adaptive_models
+         * symbol i is coded with models[ctx[i]]
+         */
+        std::vector<AdaptiveCDF<T_out>*> ptrs = py_adaptive_models<T_out>(models);
+        py_encode_adaptive(static_cast<RangeCodingEncoder<T_in, T_out>&>(*this), sym_buf, &ctx_buf, ptrs.data());
+    }
+    void encode_bit(const int &bit, const int &p){
+        /* args: See RangeCodingEncoder::encode_bit */
+        RangeCodingEncoder<T_in, T_out>::encode_bit(bit, p);
+    }
+    void encode_bits(const buffer &bits_buf, const buffer &p_buf){
+        /* bits_buf:
+         * * 1D memoryview of uint8 / bool array, one bit per item
+         * p_buf:
+         * * 1D memoryview of uint16 array, probability of 0 of each bit, See RangeCodingEncoder::encode_bit
+         */
+        buffer_info bits_info = bits_buf.request();
+        buffer_info p_info = p_buf.request();
+        gil_scoped_release release;
+        py_check_bits(bits_info, p_info, sizeof(uint16_t));
+        RangeCodingEncoder<T_in, T_out>::encode_bits(reinterpret_cast<uint8_t*>(bits_info.ptr), bits_info.shape[0], reinterpret_cast<uint16_t*>(p_info.ptr));
+    }
+    void encode_bits_adaptive(const buffer &bits_buf, const buffer &ctx_buf, PYBitModels &models){
+        /* bits_buf:
+         * * See encode_bits
+         * ctx_buf:
+         * * 1D memoryview of int32 array, context of each bit, index into models
+         * models:
+         * * bit_models_t, updated in place
+         */
+        buffer_info bits_info = bits_buf.request();
+        buffer_info ctx_info = ctx_buf.request();
+        gil_scoped_release release;
+        py_check_bits(bits_info, ctx_info, sizeof(int32_t));
+        RangeCodingEncoder<T_in, T_out>::encode_bits(reinterpret_cast<uint8_t*>(bits_info.ptr), bits_info.shape[0], models.models.data(), reinterpret_cast<int32_t*>(ctx_info.ptr));
+    }
+};
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class PYRangeCodingDecoder : public RangeCodingDecoder<T_in, T_out> {
+  public:
+    PYRangeCodingDecoder(const BitStream &encode_bit_stream): RangeCodingDecoder<T_in, T_out>(32, encode_bit_stream) {
+        /* args: See RangeCodingDecoder */
+    }
+    PYRangeCodingDecoder(const int &precision, const BitStream &encode_bit_stream): RangeCodingDecoder<T_in, T_out>(precision, encode_bit_stream) {
+        /* args: See RangeCodingDecoder */
+    }
+    ~PYRangeCodingDecoder(){}
+    T_out decode(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder */
+        buffer_info cdf_info = cdf_buf.request();
+        return RangeCodingDecoder<T_in, T_out>::decode(sym_cnt,
+                                                       reinterpret_cast<T_out*> (cdf_info.ptr),
+                                                       cdf_bits);
+    }
+    void decode_nx1(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder
+         * the cdf is prepared once as a CDFTable
+         */
+        buffer_info cdf_info = cdf_buf.request();
+        assert(static_cast<int>(cdf_info.ndim) == 1);
+        CDFTable<T_out> table(sym_cnt, reinterpret_cast<T_out*>(cdf_info.ptr), cdf_bits);
+        py_decode_nd<T_out>(cdf_buf, out_buf, [this, &table](const T_out*){
+            return RangeCodingDecoder<T_in, T_out>::decode(table);
+        });
+    }
+    void decode_nxn(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf, const bool &escape){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder
+         * with set_table_cache, cdf rows are decoded through a CDFTableCache
+         */
+        RangeCodingDecoder<T_in, T_out> &dec = *this;
+        std::shared_ptr<CDFTableCache<T_out> > cache = _table_cache;
+        py_decode_nd<T_out>(cdf_buf, out_buf, [&dec, &cache, &sym_cnt, &cdf_bits, &escape](const T_out *cdf){
+            T_out sym = cache ? dec.decode(cache->get(sym_cnt, cdf, cdf_bits)) : dec.decode(sym_cnt, cdf, cdf_bits);
+            return escape ? read_escape(dec, static_cast<int64_t>(sym), sym_cnt) : static_cast<int64_t>(sym);
+        });
+    }
+    void decode_group(const int &sym_cnt, const buffer &pos_buf, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See PYArithmeticCodingDecoder::decode_group */
+        py_decode_group<T_out>(pos_buf, cdf_buf, out_buf, [this, &sym_cnt, &cdf_bits](const T_out *cdf){
+            return RangeCodingDecoder<T_in, T_out>::decode(sym_cnt, cdf, cdf_bits);
+        });
+    }
+    void decode_param(const buffer &mean_buf, const buffer &scale_buf, const ParametricCDFBank<T_out> &bank, const buffer &out_buf){
+        /* args: See py_decode_param, ParametricCDFBank */
+        py_decode_param(static_cast<RangeCodingDecoder<T_in, T_out>&>(*this), bank, mean_buf, scale_buf, out_buf);
+    }
+    void decode_adaptive(AdaptiveCDF<T_out> &model, const buffer &out_buf){
+        /* args: See py_decode_adaptive, encode_adaptive */
+        AdaptiveCDF<T_out> *models[1] = {&model};
+        py_decode_adaptive(static_cast<RangeCodingDecoder<T_in, T_out>&>(*this), nullptr, models, out_buf);
+    }
+    void decode_context(const buffer &ctx_buf, const list &models, const buffer &out_buf){
+        /* args: See py_decode_adaptive, encode_context */
+        std::vector<AdaptiveCDF<T_out>*> ptrs = py_adaptive_models<T_out>(models);
+        py_decode_adaptive(static_cast<RangeCodingDecoder<T_in, T_out>&>(*this), &ctx_buf, ptrs.data(), out_buf);
+    }
+    int decode_bit(const int &p){
+        /* args: See RangeCodingEncoder::encode_bit */
+        return RangeCodingDecoder<T_in, T_out>::decode_bit(p);
+    }
+    void decode_bits(const buffer &p_buf, const buffer &out_buf){
+        /* out_buf:
+         * * 1D memoryview of uint8 / bool array to hold the decoded bits
+         * other args: See PYRangeCodingEncoder::encode_bits
+         */
+        buffer_info p_info = p_buf.request();
+        buffer_info out_info = out_buf.request(true);
+        gil_scoped_release release;
+        py_check_bits(out_info, p_info, sizeof(uint16_t));
+        RangeCodingDecoder<T_in, T_out>::decode_bits(reinterpret_cast<uint8_t*>(out_info.ptr), out_info.shape[0], reinterpret_cast<uint16_t*>(p_info.ptr));
+    }
+    void decode_bits_adaptive(const buffer &ctx_buf, PYBitModels &models, const buffer &out_buf){
+        /* args: See decode_bits, PYRangeCodingEncoder::encode_bits_adaptive */
+        buffer_info ctx_info = ctx_buf.request();
+        buffer_info out_info = out_buf.request(true);
+        gil_scoped_release release;
+        py_check_bits(out_info, ctx_info, sizeof(int32_t));
+        RangeCodingDecoder<T_in, T_out>::decode_bits(reinterpret_cast<uint8_t*>(out_info.ptr), out_info.shape[0], models.models.data(), reinterpret_cast<int32_t*>(ctx_info.ptr));
     }
+    void set_table_cache(const int &capacity){
+        /* capacity:
+         * * number of CDFTable kept for decode_nxn, 0 disables the cache
+         * * worth it when cdf rows repeat, e.g. cdf picked from a small set per channel
+         */
+        if(capacity > 0)
+            _table_cache = std::make_shared<CDFTableCache<T_out> >(capacity);
+        else
+            _table_cache.reset();
+    }
+  private:
+    std::shared_ptr<CDFTableCache<T_out> > _table_cache;
 };
 template <typename T_in, typename T_out>
 /* template args: see ArithmeticCodingEncoder */
@@ -125,7 +801,7 @@ class PYRANSCodec : public RANSCodec<T_in, T_out> {
     PYRANSCodec(const BitStream &encode_bit_stream): RANSCodec<T_in, T_out>(64, 32, encode_bit_stream) {
         /* args: See RANSCodec */
     }
-    PYRANSCodec(const int &h_precision, const int &t_precision, const BitStream &encode_bit_stream): RANSCodec<T_in, T_out>(h_precision, t_precision) {
+    PYRANSCodec(const int &h_precision, const int &t_precision, const BitStream &encode_bit_stream): RANSCodec<T_in, T_out>(h_precision, t_precision, encode_bit_stream) {
         /* args: See RANSCodec */
     }
     ~PYRANSCodec(){}
@@ -137,27 +813,73 @@ class PYRANSCodec : public RANSCodec<T_in, T_out> {
                                        cdf_bits);
     }
     void encode_nx1(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
-        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder */
-        buffer_info sym_info = sym_buf.request();
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder
+         * the cdf is prepared once as a RANSEncTable
+         */
         buffer_info cdf_info = cdf_buf.request();
-        assert(static_cast<int>(sym_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 1);
-        for(int i = 0; i < sym_info.shape[0]; i++){
-            RANSCodec<T_in, T_out>::encode((reinterpret_cast<T_out*>(sym_info.ptr))[i],
-                                            reinterpret_cast<T_out*>(cdf_info.ptr),
-                                            cdf_bits);
+        assert(static_cast<int>(cdf_info.ndim) == 1);
+        RANSEncTable<T_in, T_out> table(static_cast<int>(cdf_info.shape[0]) - 1,
+                                        reinterpret_cast<T_out*>(cdf_info.ptr),
+                                        cdf_bits,
+                                        RANSCodec<T_in, T_out>::h_precision());
+        py_encode_nd<T_out>(sym_buf, cdf_buf, [this, &table](const T_out &sym, const T_out*){
+            RANSCodec<T_in, T_out>::encode(sym, table);
+        });
+    }
+    void encode_nxn(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits, const bool &escape){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder
+         * with escape, the bypass bits of each escaped symbol are pushed before its escape bin, so
+         * decode_nxn reads the bin and then the bits, See encode_escape
+         */
+        if(escape){
+            RANSCodec<T_in, T_out> &enc = *this;
+            const int sym_cnt = py_sym_cnt(cdf_buf);
+            py_encode_nd<T_out>(sym_buf, cdf_buf, [&enc, &sym_cnt, &cdf_bits](const int64_t &sym, const T_out *cdf){
+                encode_escape(enc, sym, sym_cnt, cdf, cdf_bits);
+            });
+            return;
         }
+        py_encode_nd<T_out>(sym_buf, cdf_buf, [this, &cdf_bits](const T_out &sym, const T_out *cdf){
+            RANSCodec<T_in, T_out>::encode(sym, cdf, cdf_bits);
+        });
     }
-    void encode_nxn(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
-        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder */
+    void encode_group(const buffer &sym_buf, const buffer &pos_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See PYArithmeticCodingEncoder::encode_group
+         * rans is lifo: the group is coded backwards, so call once per group in reverse decoding order
+         * (the cdfs of all groups are known to the encoder) and decode_group returns each group in order
+         */
+        py_encode_group<T_out>(sym_buf, pos_buf, cdf_buf, true, [this, &cdf_bits](const T_out &sym, const T_out *cdf){
+            RANSCodec<T_in, T_out>::encode(sym, cdf, cdf_bits);
+        });
+    }
+    void encode_nxn_indexed(const buffer &sym_buf, const buffer &index_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder
+         * index_buf
+         * * 1D memory view of cdf index array, symbol i is coded with cdf row index[i]
+         * * * dim 1 = N (symbol to encode)
+         * cdf_buf:
+         * * 2D memoryview of a cdf bank, e.g. quantized gaussian cdf of each scale
+         * * * dim 1 = K (cdf in bank)
+         * * * dim 2 = alphabet size + 1
+         * one RANSEncTable is built for each row in use
+         * sym and index take any integer dtype and stride, See py_dispatch_int. a shape mismatch
+         * throws std::invalid_argument and an index outside the bank std::out_of_range
+         */
         buffer_info sym_info = sym_buf.request();
+        buffer_info index_info = index_buf.request();
         buffer_info cdf_info = cdf_buf.request();
-        assert(static_cast<int>(sym_info.ndim == 1) && static_cast<int>(cdf_info.ndim) == 2);
-        assert(static_cast<int>(sym_info.shape[0]) == static_cast<int>(cdf_info.shape[0]));
-        assert(sizeof(T_out) == cdf_info.strides[1]);
-        for(int i = 0; i < sym_info.shape[0]; i++){
-            RANSCodec<T_in, T_out>::encode((reinterpret_cast<T_out*>(sym_info.ptr))[i],
-                                            reinterpret_cast<T_out*>(cdf_info.ptr) + i * (cdf_info.strides[0] / cdf_info.strides[1]),
-                                            cdf_bits);
+        const std::vector<int64_t> sym = py_gather_1d(sym_info);
+        const std::vector<int64_t> index = py_gather_1d(index_info);
+        if(sym.size() != index.size())
+            throw std::invalid_argument("encode_nxn_indexed: sym and index differ in length");
+        const std::vector<const T_out*> rows = py_bank_rows<T_out>(cdf_info, index);
+        gil_scoped_release release;
+        std::vector<std::unique_ptr<RANSEncTable<T_in, T_out> > > tables(cdf_info.shape[0]);
+        for(size_t i = 0; i < sym.size(); i++){
+            if(!tables[index[i]])
+                tables[index[i]].reset(new RANSEncTable<T_in, T_out>(static_cast<int>(cdf_info.shape[1]) - 1, rows[i], cdf_bits,
+                                                                     RANSCodec<T_in, T_out>::h_precision()));
+            RANSCodec<T_in, T_out>::encode(static_cast<T_out>(sym[i]), *tables[index[i]]);
         }
     }
     T_out decode(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits){
@@ -168,59 +890,658 @@ class PYRANSCodec : public RANSCodec<T_in, T_out> {
                                               cdf_bits);
     }
     void decode_nx1(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
-        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder */
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder
+         * the cdf is prepared once as a CDFTable
+         */
         buffer_info cdf_info = cdf_buf.request();
-        buffer_info out_info = out_buf.request();
+        assert(static_cast<int>(cdf_info.ndim) == 1);
+        CDFTable<T_out> table(sym_cnt, reinterpret_cast<T_out*>(cdf_info.ptr), cdf_bits);
+        py_decode_nd<T_out>(cdf_buf, out_buf, [this, &table](const T_out*){
+            return RANSCodec<T_in, T_out>::decode(table);
+        });
+    }
+    void decode_nxn(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf, const bool &escape){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder
+         * with set_table_cache, cdf rows are decoded through a CDFTableCache
+         */
+        RANSCodec<T_in, T_out> &dec = *this;
+        std::shared_ptr<CDFTableCache<T_out> > cache = _table_cache;
+        py_decode_nd<T_out>(cdf_buf, out_buf, [&dec, &cache, &sym_cnt, &cdf_bits, &escape](const T_out *cdf){
+            T_out sym = cache ? dec.decode(cache->get(sym_cnt, cdf, cdf_bits)) : dec.decode(sym_cnt, cdf, cdf_bits);
+            return escape ? read_escape(dec, static_cast<int64_t>(sym), sym_cnt) : static_cast<int64_t>(sym);
+        });
+    }
+    void decode_group(const int &sym_cnt, const buffer &pos_buf, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See PYArithmeticCodingDecoder::decode_group, encode_group */
+        py_decode_group<T_out>(pos_buf, cdf_buf, out_buf, [this, &sym_cnt, &cdf_bits](const T_out *cdf){
+            return RANSCodec<T_in, T_out>::decode(sym_cnt, cdf, cdf_bits);
+        });
+    }
+    void decode_nxn_indexed(const buffer &index_buf, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See encode_nxn_indexed, decode_nx1
+         * one CDFTable is built for each row in use
+         */
+        buffer_info index_info = index_buf.request();
+        buffer_info cdf_info = cdf_buf.request();
+        buffer_info out_info = out_buf.request(true);
+        const std::vector<int64_t> index = py_gather_1d(index_info);
+        if(static_cast<int>(out_info.ndim) != 1 || out_info.shape[0] != static_cast<ssize_t>(index.size()))
+            throw std::invalid_argument("decode_nxn_indexed: out and index differ in length");
+        const std::vector<const T_out*> rows = py_bank_rows<T_out>(cdf_info, index);
+        std::vector<int64_t> out(index.size());
+        {
+            gil_scoped_release release;
+            std::vector<std::unique_ptr<CDFTable<T_out> > > tables(cdf_info.shape[0]);
+            for(size_t i = 0; i < index.size(); i++){
+                if(!tables[index[i]])
+                    tables[index[i]].reset(new CDFTable<T_out>(static_cast<int>(cdf_info.shape[1]) - 1, rows[i], cdf_bits));
+                out[i] = static_cast<int64_t>(RANSCodec<T_in, T_out>::decode(*tables[index[i]]));
+            }
+        }
+        PYScatter1D scatter = {out_info, out};
+        py_dispatch_int(out_info, scatter);
+    }
+    void encode_param(const buffer &value_buf, const buffer &mean_buf, const buffer &scale_buf, const ParametricCDFBank<T_out> &bank){
+        /* args: See py_encode_param, ParametricCDFBank */
+        py_encode_param(static_cast<RANSCodec<T_in, T_out>&>(*this), bank, value_buf, mean_buf, scale_buf);
+    }
+    void decode_param(const buffer &mean_buf, const buffer &scale_buf, const ParametricCDFBank<T_out> &bank, const buffer &out_buf){
+        /* args: See py_decode_param, ParametricCDFBank */
+        py_decode_param(static_cast<RANSCodec<T_in, T_out>&>(*this), bank, mean_buf, scale_buf, out_buf);
+    }
+    void set_table_cache(const int &capacity){
+        /* capacity:
+         * * number of CDFTable kept for decode_nxn, 0 disables the cache
+         * * worth it when cdf rows repeat, e.g. cdf picked from a small set per channel
+         */
+        if(capacity > 0)
+            _table_cache = std::make_shared<CDFTableCache<T_out> >(capacity);
+        else
+            _table_cache.reset();
+    }
+  private:
+    std::shared_ptr<CDFTableCache<T_out> > _table_cache;
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class PYTANSEncoder : public TANSEncoder<T_out> {
+  public:
+    PYTANSEncoder() {}
+    ~PYTANSEncoder(){}
+    void encode_nx1(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See PYArithmeticCodingEncoder
+         * each call codes one block, See TANSEncoder
+         */
+        buffer_info sym_info = sym_buf.request();
+        buffer_info cdf_info = cdf_buf.request();
+        gil_scoped_release release;
+        assert(static_cast<int>(sym_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 1);
+        TANSEncoder<T_out>::encode_nx1(reinterpret_cast<T_out*>(sym_info.ptr), sym_info.shape[0],
+                                       static_cast<int>(cdf_info.shape[0]) - 1, reinterpret_cast<T_out*>(cdf_info.ptr), cdf_bits);
+    }
+};
+template <typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+class PYTANSDecoder : public TANSDecoder<T_out> {
+  public:
+    PYTANSDecoder(const BitStream &encode_bit_stream): TANSDecoder<T_out>(encode_bit_stream) {
+        /* args: See TANSDecoder */
+    }
+    ~PYTANSDecoder(){}
+    void decode_nx1(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See PYArithmeticCodingDecoder
+         * out_buf must have the length of the block passed to encode_nx1
+         */
+        buffer_info cdf_info = cdf_buf.request();
+        buffer_info out_info = out_buf.request(true);
+        gil_scoped_release release;
         assert(static_cast<int>(out_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 1);
-        for(int i = 0; i < out_info.shape[0]; i++){
-            reinterpret_cast<T_out*>(out_info.ptr)[i] = RANSCodec<T_in, T_out>::decode(sym_cnt,
-                                                                                       reinterpret_cast<T_out*> (cdf_info.ptr),
-                                                                                       cdf_bits);
+        TANSDecoder<T_out>::decode_nx1(reinterpret_cast<T_out*>(out_info.ptr), out_info.shape[0], sym_cnt,
+                                       reinterpret_cast<T_out*>(cdf_info.ptr), cdf_bits);
+    }
+};
+template <typename T_in, typename T_out, int N_lane>
+/* template args: see InterleavedRANSCodec */
+class PYInterleavedRANSCodec : public InterleavedRANSCodec<T_in, T_out, N_lane> {
+  public:
+    PYInterleavedRANSCodec(): InterleavedRANSCodec<T_in, T_out, N_lane>(64, 32) {}
+    PYInterleavedRANSCodec(const int &h_precision, const int &t_precision): InterleavedRANSCodec<T_in, T_out, N_lane>(h_precision, t_precision) {
+        /* args: See RANSCodec */
+    }
+    PYInterleavedRANSCodec(const BitStream &encode_bit_stream): InterleavedRANSCodec<T_in, T_out, N_lane>(64, 32, encode_bit_stream) {
+        /* args: See RANSCodec */
+    }
+    PYInterleavedRANSCodec(const int &h_precision, const int &t_precision, const BitStream &encode_bit_stream): InterleavedRANSCodec<T_in, T_out, N_lane>(h_precision, t_precision, encode_bit_stream) {
+        /* args: See RANSCodec */
+    }
+    ~PYInterleavedRANSCodec(){}
+    void encode(const int &sym, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder */
+        buffer_info cdf_info = cdf_buf.request();
+        InterleavedRANSCodec<T_in, T_out, N_lane>::encode(sym,
+                                                          reinterpret_cast<T_out*> (cdf_info.ptr),
+                                                          cdf_bits);
+    }
+    void encode_nx1(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder */
+        encode_nxn(sym_buf, cdf_buf, cdf_bits);
+    }
+    void encode_nxn(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder
+         * contiguous 1D int32 symbols go through the lane parallel encode_n,
+         * other layouts and dtypes are coded one symbol at a time
+         */
+        buffer_info sym_info = sym_buf.request();
+        buffer_info cdf_info = cdf_buf.request();
+        if(!py_is_flat<T_out>(sym_info, cdf_info)){
+            py_encode_nd<T_out>(sym_buf, cdf_buf, [this, &cdf_bits](const T_out &sym, const T_out *cdf){
+                InterleavedRANSCodec<T_in, T_out, N_lane>::encode(sym, cdf, cdf_bits);
+            });
+            return;
         }
+        gil_scoped_release release;
+        InterleavedRANSCodec<T_in, T_out, N_lane>::encode_n(reinterpret_cast<T_out*>(sym_info.ptr),
+                                                            sym_info.shape[0],
+                                                            reinterpret_cast<T_out*>(cdf_info.ptr),
+                                                            cdf_info.ndim == 2 ? cdf_info.strides[0] / cdf_info.strides[1] : 0,
+                                                            cdf_bits);
+    }
+    T_out decode(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder */
+        buffer_info cdf_info = cdf_buf.request();
+        return InterleavedRANSCodec<T_in, T_out, N_lane>::decode(sym_cnt,
+                                                                 reinterpret_cast<T_out*> (cdf_info.ptr),
+                                                                 cdf_bits);
+    }
+    void decode_nx1(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder */
+        decode_nxn(sym_cnt, cdf_buf, cdf_bits, out_buf);
     }
     void decode_nxn(const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder, encode_nxn */
+        buffer_info cdf_info = cdf_buf.request();
+        buffer_info out_info = out_buf.request(true);
+        if(!py_is_flat<T_out>(out_info, cdf_info)){
+            py_decode_nd<T_out>(cdf_buf, out_buf, [this, &sym_cnt, &cdf_bits](const T_out *cdf){
+                return InterleavedRANSCodec<T_in, T_out, N_lane>::decode(sym_cnt, cdf, cdf_bits);
+            });
+            return;
+        }
+        gil_scoped_release release;
+        InterleavedRANSCodec<T_in, T_out, N_lane>::decode_n(reinterpret_cast<T_out*>(out_info.ptr),
+                                                            out_info.shape[0],
+                                                            sym_cnt,
+                                                            reinterpret_cast<T_out*>(cdf_info.ptr),
+                                                            cdf_info.ndim == 2 ? cdf_info.strides[0] / cdf_info.strides[1] : 0,
+                                                            cdf_bits);
+    }
+};
+template <typename T_in, typename T_out>
+/* template args: see ChunkedCodec */
+class PYChunkedCodec : public ChunkedCodec<T_in, T_out> {
+  public:
+    PYChunkedCodec(const CodecType &codec, const int &chunks, const int &threads): ChunkedCodec<T_in, T_out>(CodecParams(codec), chunks, threads) {
+        /* args: See ChunkedCodec, threads <= 0 uses all cores */
+    }
+    PYChunkedCodec(const CodecType &codec, const int &precision, const int &h_precision, const int &t_precision, const int &chunks, const int &threads):
+        ChunkedCodec<T_in, T_out>(CodecParams(codec, precision, h_precision, t_precision), chunks, threads) {
+        /* args: See CodecParams, ChunkedCodec */
+    }
+    ~PYChunkedCodec(){}
+    BitStream encode_nx1(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder
+         * return: the chunked stream
+         */
+        buffer_info sym_info = sym_buf.request();
+        buffer_info cdf_info = cdf_buf.request();
+        gil_scoped_release release;
+        assert(static_cast<int>(sym_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 1);
+        return ChunkedCodec<T_in, T_out>::encode(reinterpret_cast<T_out*>(sym_info.ptr),
+                                                 sym_info.shape[0],
+                                                 reinterpret_cast<T_out*>(cdf_info.ptr),
+                                                 0,
+                                                 cdf_bits);
+    }
+    BitStream encode_nxn(const buffer &sym_buf, const buffer &cdf_buf, const int &cdf_bits){
+        /* args: See ArithmeticCodingEncoder, PYArithmeticCodingEncoder
+         * return: the chunked stream
+         */
+        buffer_info sym_info = sym_buf.request();
+        buffer_info cdf_info = cdf_buf.request();
+        gil_scoped_release release;
+        assert(static_cast<int>(sym_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 2);
+        assert(static_cast<int>(sym_info.shape[0]) == static_cast<int>(cdf_info.shape[0]));
+        assert(sizeof(T_out) == cdf_info.strides[1]);
+        return ChunkedCodec<T_in, T_out>::encode(reinterpret_cast<T_out*>(sym_info.ptr),
+                                                 sym_info.shape[0],
+                                                 reinterpret_cast<T_out*>(cdf_info.ptr),
+                                                 cdf_info.strides[0] / cdf_info.strides[1],
+                                                 cdf_bits);
+    }
+    void decode_nx1(BitStream &bit_stream, const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
+        /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder */
+        buffer_info cdf_info = cdf_buf.request();
+        buffer_info out_info = out_buf.request();
+        gil_scoped_release release;
+        assert(static_cast<int>(out_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 1);
+        ChunkedCodec<T_in, T_out>::decode(bit_stream,
+                                          reinterpret_cast<T_out*>(out_info.ptr),
+                                          out_info.shape[0],
+                                          sym_cnt,
+                                          reinterpret_cast<T_out*>(cdf_info.ptr),
+                                          0,
+                                          cdf_bits);
+    }
+    void decode_nxn(BitStream &bit_stream, const int &sym_cnt, const buffer &cdf_buf, const int &cdf_bits, const buffer &out_buf){
         /* args: See ArithmeticCodingDecoder, PYArithmeticCodingDecoder */
         buffer_info cdf_info = cdf_buf.request();
         buffer_info out_info = out_buf.request();
+        gil_scoped_release release;
         assert(static_cast<int>(out_info.ndim) == 1 && static_cast<int>(cdf_info.ndim) == 2);
         assert(static_cast<int>(out_info.shape[0]) == static_cast<int>(cdf_info.shape[0]));
-        for(int i = 0; i < out_info.shape[0]; i++){
-            reinterpret_cast<T_out*>(out_info.ptr)[i] = RANSCodec<T_in, T_out>::decode(sym_cnt,
-                                                                                       reinterpret_cast<T_out*> (cdf_info.ptr) + i * (cdf_info.strides[0] / cdf_info.strides[1]),
-                                                                                       cdf_bits);
-        }
+        ChunkedCodec<T_in, T_out>::decode(bit_stream,
+                                          reinterpret_cast<T_out*>(out_info.ptr),
+                                          out_info.shape[0],
+                                          sym_cnt,
+                                          reinterpret_cast<T_out*>(cdf_info.ptr),
+                                          cdf_info.strides[0] / cdf_info.strides[1],
+                                          cdf_bits);
     }
 };
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+std::vector<BitStream> encode_batch(const CodecType &codec, const list &sym_list, const list &cdf_list, const int &cdf_bits, const int &threads,
+                                    const int &precision, const int &h_precision, const int &t_precision){
+    /* codec, precision, h_precision, t_precision:
+     * * See CodecParams
+     * sym_list:
+     * * list of 1D memoryview of symbol array, one per tensor
+     * cdf_list:
+     * * list of 1D (nx1) or 2D (nxn) memoryview of cdf array, one per tensor
+     * threads:
+     * * See ThreadPool
+     * return:
+     * * list of flushed bit_stream_t, one per tensor, decode them with decode_batch
+     */
+    assert(sym_list.size() == cdf_list.size());
+    size_t n = sym_list.size();
+    std::vector<buffer_info> sym_infos, cdf_infos;
+    for(size_t i = 0; i < n; i++){
+        sym_infos.push_back(sym_list[i].cast<buffer>().request());
+        cdf_infos.push_back(cdf_list[i].cast<buffer>().request());
+        assert(static_cast<int>(sym_infos[i].ndim) == 1);
+        assert(static_cast<int>(cdf_infos[i].ndim) == 1 || sym_infos[i].shape[0] == cdf_infos[i].shape[0]);
+    }
+    std::vector<BitStream> streams(n);
+    gil_scoped_release release;
+    CodecParams params(codec, precision, h_precision, t_precision);
+    ThreadPool pool(threads);
+    pool.parallel_for(n, [&](int64_t i){
+        const buffer_info &sym_info = sym_infos[i];
+        const buffer_info &cdf_info = cdf_infos[i];
+        streams[i] = encode_symbols<T_in, T_out>(params,
+                                                 reinterpret_cast<T_out*>(sym_info.ptr),
+                                                 sym_info.shape[0],
+                                                 reinterpret_cast<T_out*>(cdf_info.ptr),
+                                                 cdf_info.ndim == 1 ? 0 : cdf_info.strides[0] / cdf_info.strides[1],
+                                                 cdf_bits);
+    });
+    return streams;
+}
+template <typename T_in, typename T_out>
+/* template args: see ArithmeticCodingEncoder */
+void decode_batch(const CodecType &codec, const list &stream_list, const int &sym_cnt, const list &cdf_list, const int &cdf_bits, const list &out_list,
+                  const int &threads, const int &precision, const int &h_precision, const int &t_precision){
+    /* stream_list:
+     * * list of bit_stream_t from encode_batch
+     * out_list:
+     * * list of 1D memoryview to hold the decoded symbols, one per tensor
+     * other args: See encode_batch
+     */
+    assert(stream_list.size() == cdf_list.size() && stream_list.size() == out_list.size());
+    size_t n = stream_list.size();
+    std::vector<const BitStream*> streams;
+    std::vector<buffer_info> cdf_infos, out_infos;
+    for(size_t i = 0; i < n; i++){
+        streams.push_back(&stream_list[i].cast<const BitStream &>());
+        cdf_infos.push_back(cdf_list[i].cast<buffer>().request());
+        out_infos.push_back(out_list[i].cast<buffer>().request(true));
+        assert(static_cast<int>(out_infos[i].ndim) == 1);
+        assert(static_cast<int>(cdf_infos[i].ndim) == 1 || out_infos[i].shape[0] == cdf_infos[i].shape[0]);
+    }
+    gil_scoped_release release;
+    CodecParams params(codec, precision, h_precision, t_precision);
+    ThreadPool pool(threads);
+    pool.parallel_for(n, [&](int64_t i){
+        const buffer_info &cdf_info = cdf_infos[i];
+        const buffer_info &out_info = out_infos[i];
+        decode_symbols<T_in, T_out>(params,
+                                    *streams[i],
+                                    reinterpret_cast<T_out*>(out_info.ptr),
+                                    out_info.shape[0],
+                                    sym_cnt,
+                                    reinterpret_cast<T_out*>(cdf_info.ptr),
+                                    cdf_info.ndim == 1 ? 0 : cdf_info.strides[0] / cdf_info.strides[1],
+                                    cdf_bits);
+    });
+}
+BitStream bit_stream_view(const buffer &buf){
+    /* buf:
+     * * 1D contiguous buffer, e.g. bytes, mmap, numpy uint8 array
+     * return:
+     * * read only BitStream over buf without copy, buf is kept alive (and locked) by the stream
+     */
+    std::shared_ptr<buffer_info> info(new buffer_info(buf.request()), [](buffer_info *p){
+        gil_scoped_acquire acquire;
+        delete p;
+    });
+    assert(static_cast<int>(info->ndim) == 1 && info->strides[0] == info->itemsize);
+    return BitStream::view(reinterpret_cast<const uint8_t*>(info->ptr), info->shape[0] * info->itemsize, info);
+}
+void bit_stream_release_owner(void *owner){
+    delete static_cast<std::shared_ptr<const void>*>(owner);
+}
+buffer_info bit_stream_buffer(BitStream &bit_stream){
+    /* read only 1D uint8 view of the stream bytes for the buffer protocol, last byte zero padded
+     * no copy: the stream is turned into a view of a shared buffer the export keeps alive, and the
+     * next write of the stream copies its bytes back, See BitStream::share. so the exported bytes
+     * stay valid whatever is done to the stream later. only a stream with a sink, a source or marks
+     * exports a snapshot copy
+     */
+    std::shared_ptr<const void> owner;
+    if(bit_stream.share())
+        owner = bit_stream.owner();
+    const uint8_t *data = bit_stream.data();
+    size_t len = bit_stream.byte_size();
+    if(!owner){
+        std::shared_ptr<std::vector<uint8_t>> copy = std::make_shared<std::vector<uint8_t>>(data, data + len);
+        data = copy->data();
+        owner = copy;
+    }
+    capsule keep(new std::shared_ptr<const void>(owner), &bit_stream_release_owner);
+    Py_buffer *view = new Py_buffer();
+    if(PyBuffer_FillInfo(view, keep.ptr(), const_cast<uint8_t*>(data), static_cast<ssize_t>(len), 1, PyBUF_FULL_RO) != 0){
+        delete view;
+        throw error_already_set();
+    }
+    return buffer_info(view);
+}
+std::vector<int> adaptive_cdf_values(const AdaptiveCDF<int> &model){
+    /* copy of the current cdf, sym_cnt + 1 entries */
+    return std::vector<int>(model.cdf(), model.cdf() + model.sym_cnt() + 1);
+}
+bytes bit_stream_get_data(BitStream &bit_stream){
+    /* copy of the stream bytes, last byte zero padded */
+    return bytes(reinterpret_cast<const char*>(bit_stream.data()), bit_stream.byte_size());
+}
+void bit_stream_set_data(BitStream &bit_stream, const bytes &data){
+    /* replace the stream with a copy of data */
+    char *buf;
+    Py_ssize_t len;
+    PyBytes_AsStringAndSize(data.ptr(), &buf, &len);
+    bit_stream = BitStream(reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(len));
+}
+std::shared_ptr<function> shared_function(const function &fn){
+    /* the coders may copy or drop the callback without the GIL, so the last reference
+     * takes the GIL to release it
+     */
+    return std::shared_ptr<function>(new function(fn), [](function *p){
+        gil_scoped_acquire acquire;
+        delete p;
+    });
+}
+void bit_stream_set_sink(BitStream &bit_stream, const function &sink, const size_t &capacity){
+    /* sink:
+     * * callable taking bytes, e.g. the write method of a file opened with "wb"
+     * capacity:
+     * * See BitStream::set_sink
+     */
+    std::shared_ptr<function> fn = shared_function(sink);
+    bit_stream.set_sink([fn](const uint8_t *data, size_t len){
+        gil_scoped_acquire acquire;
+        (*fn)(bytes(reinterpret_cast<const char*>(data), len));
+    }, capacity);
+}
+void bit_stream_set_source(BitStream &bit_stream, const function &source, const size_t &capacity){
+    /* source:
+     * * callable taking a byte count n and returning at most n bytes, b"" at end of stream,
+     * * e.g. the read method of a file opened with "rb"
+     * capacity:
+     * * See BitStream::set_source
+     */
+    std::shared_ptr<function> fn = shared_function(source);
+    bit_stream.set_source([fn](uint8_t *data, size_t len){
+        gil_scoped_acquire acquire;
+        bytes chunk = (*fn)(len).cast<bytes>();
+        char *buf;
+        Py_ssize_t chunk_len;
+        PyBytes_AsStringAndSize(chunk.ptr(), &buf, &chunk_len);
+        assert(static_cast<size_t>(chunk_len) <= len);
+        std::copy(buf, buf + chunk_len, data);
+        return static_cast<size_t>(chunk_len);
+    }, capacity);
+}
+int stream_container_add(StreamContainer &container, const std::string &name, const BitStream &bit_stream, const CodecType &codec, const int &cdf_bits,
+                         const int &precision, const int &h_precision, const int &t_precision, const uint64_t &sym_count){
+    /* args: See StreamContainer::add, CodecParams */
+    return container.add(name, bit_stream, CodecParams(codec, precision, h_precision, t_precision), cdf_bits, sym_count);
+}
+template <typename T_codec>
+dict codec_stats(const T_codec &codec){
+    /* the counters of codec.stats() by name, See CodecStats */
+    const CodecStats &stats = codec.stats();
+    dict d;
+    d["symbols"] = stats.symbols;
+    d["ideal_bits"] = stats.ideal_bits;
+    d["renorm"] = stats.renorm;
+    d["pending"] = stats.pending;
+    d["max_pending"] = stats.max_pending;
+    d["carries"] = stats.carries;
+    return d;
+}
 typedef BitStream bit_stream_t;
+typedef ParametricCDFBank<int> param_cdf_bank_t;
+typedef AdaptiveCDF<int> adaptive_cdf_t;
+typedef PYBitModels bit_models_t;
 typedef PYArithmeticCodingEncoder<uint64_t, int> ac_encoder_t;
 typedef PYArithmeticCodingDecoder<uint64_t, int> ac_decoder_t;
+typedef PYRangeCodingEncoder<uint64_t, int> range_encoder_t;
+typedef PYRangeCodingDecoder<uint64_t, int> range_decoder_t;
 typedef PYRANSCodec<uint64_t, int> rans_codec_t;
+typedef RANSSnapshot<uint64_t> rans_snapshot_t;
+typedef PYInterleavedRANSCodec<uint64_t, int, 2> rans_x2_codec_t;
+typedef PYInterleavedRANSCodec<uint64_t, int, 4> rans_x4_codec_t;
+typedef PYInterleavedRANSCodec<uint64_t, int, 8> rans_x8_codec_t;
+typedef PYInterleavedRANSCodec<uint64_t, int, 16> rans_x16_codec_t;
+typedef PYChunkedCodec<uint64_t, int> chunked_codec_t;
+typedef PYTANSEncoder<int> tans_encoder_t;
+typedef PYTANSDecoder<int> tans_decoder_t;
+typedef SubstreamInfo substream_info_t;
+typedef StreamContainer stream_container_t;
 /* you can define your own type with any width and add it to PYBIND11_MODULE
  * see more: https://pybind11.readthedocs.io/en/stable/
  */
+template <typename T_codec>
+void bind_interleaved_rans(module_ &m, const char *name){
+    class_<T_codec>(m, name)
+        .def(init<>())
+        .def(init<const int &, const int &>())
+        .def(init<const bit_stream_t &>())
+        .def(init<const int &, const int &, const bit_stream_t &>())
+        .def_readwrite("bit_stream", &T_codec::bit_stream)
+        .def("encode", &T_codec::encode)
+        .def("encode_nx1", &T_codec::encode_nx1)
+        .def("encode_nxn", &T_codec::encode_nxn)
+        .def("flush", &T_codec::flush)
+        .def("reset", static_cast<void (T_codec::*)()>(&T_codec::reset))
+        .def("reset", static_cast<void (T_codec::*)(const bit_stream_t &)>(&T_codec::reset))
+        .def("decode", &T_codec::decode)
+        .def("decode_nx1", &T_codec::decode_nx1)
+        .def("decode_nxn", &T_codec::decode_nxn)
+        .def("stats", &codec_stats<T_codec>)
+        .def("reset_stats", &T_codec::reset_stats);
+}
 PYBIND11_MODULE(yaecl, m) {
     m.doc() = "yaecl python library";
-    class_<bit_stream_t>(m, "bit_stream_t")
+    m.def("stats_enabled", &CodecStats::enabled);
+    enum_<CodecType>(m, "codec_type_t")
+        .value("AC", CodecType::AC)
+        .value("RANGE", CodecType::RANGE)
+        .value("RANS", CodecType::RANS);
+    enum_<SimdLevel>(m, "simd_level_t")
+        .value("SCALAR", SimdLevel::SCALAR)
+        .value("AVX2", SimdLevel::AVX2)
+        .value("AVX512", SimdLevel::AVX512);
+    m.def("simd_level", &simd_level);
+    m.def("set_simd_level", &set_simd_level);
+    enum_<Distribution>(m, "distribution_t")
+        .value("GAUSSIAN", Distribution::GAUSSIAN)
+        .value("LAPLACE", Distribution::LAPLACE)
+        .value("LOGISTIC", Distribution::LOGISTIC);
+    class_<param_cdf_bank_t>(m, "param_cdf_bank_t")
+        .def(init<const Distribution &, const std::vector<double> &, const int &, const double &, const bool &>(),
+             arg("dist"), arg("scale_table") = param_cdf_bank_t::default_scale_table(), arg("cdf_bits") = 16, arg("tail_mass") = 1e-9,
+             arg("escape") = true)
+        .def_static("default_scale_table", &param_cdf_bank_t::default_scale_table,
+                    arg("min") = 0.11, arg("max") = 256, arg("levels") = 64)
+        .def("index", &param_cdf_bank_t::index<double>)
+        .def("sym_cnt", &param_cdf_bank_t::sym_cnt)
+        .def("center", &param_cdf_bank_t::center)
+        .def("escape", &param_cdf_bank_t::escape)
+        .def("size", &param_cdf_bank_t::size);
+    class_<adaptive_cdf_t>(m, "adaptive_cdf_t")
+        .def(init<const int &, const int &, const int &>(), arg("sym_cnt"), arg("cdf_bits") = 15, arg("rate") = 0)
+        .def("update", &adaptive_cdf_t::update)
+        .def("reset", &adaptive_cdf_t::reset)
+        .def("cdf", &adaptive_cdf_values)
+        .def("sym_cnt", &adaptive_cdf_t::sym_cnt)
+        .def("cdf_bits", &adaptive_cdf_t::cdf_bits);
+    class_<bit_models_t>(m, "bit_models_t")
+        .def(init<const int &, const int &>(), arg("count"), arg("shift") = 4)
+        .def("reset", &bit_models_t::reset)
+        .def("p", &bit_models_t::p)
+        .def("size", &bit_models_t::size);
+    class_<bit_stream_t>(m, "bit_stream_t", buffer_protocol())
         .def(init<>())
+        .def(init(&bit_stream_view))
+        .def_buffer(&bit_stream_buffer)
         .def("size", &bit_stream_t::size)
         .def("save", &bit_stream_t::save)
         .def("load", &bit_stream_t::load)
-        .def_property("data", &bit_stream_t::getData, &bit_stream_t::setData, "py::bytes");
+        .def_static("map", &bit_stream_t::map)
+        .def("set_sink", &bit_stream_set_sink, arg("sink"), arg("capacity") = 1 << 16)
+        .def("set_source", &bit_stream_set_source, arg("source"), arg("capacity") = 1 << 16)
+        .def("drain", &bit_stream_t::drain)
+        .def("reserve", &bit_stream_t::reserve)
+        .def("capacity", &bit_stream_t::capacity)
+        .def("clear", &bit_stream_t::clear)
+        .def_property("data", &bit_stream_get_data, &bit_stream_set_data, "py::bytes");
+    class_<substream_info_t>(m, "substream_info_t")
+        .def_readonly("name", &substream_info_t::name)
+        .def_readonly("codec", &substream_info_t::codec)
+        .def_readonly("precision", &substream_info_t::precision)
+        .def_readonly("h_precision", &substream_info_t::h_precision)
+        .def_readonly("t_precision", &substream_info_t::t_precision)
+        .def_readonly("cdf_bits", &substream_info_t::cdf_bits)
+        .def_readonly("sym_count", &substream_info_t::sym_count)
+        .def_readonly("offset", &substream_info_t::offset)
+        .def_readonly("length", &substream_info_t::length);
+    class_<stream_container_t>(m, "stream_container_t")
+        .def(init<>())
+        .def(init<const bit_stream_t &>())
+        .def_static("open", &stream_container_t::open)
+        .def("add", &stream_container_add,
+             arg("name"), arg("bit_stream"), arg("codec"), arg("cdf_bits"),
+             arg("precision") = 32, arg("h_precision") = 64, arg("t_precision") = 32, arg("sym_count") = 0)
+        .def("size", &stream_container_t::size)
+        .def("info", &stream_container_t::info)
+        .def("find", &stream_container_t::find)
+        .def("substream", &stream_container_t::substream)
+        .def("write", &stream_container_t::write)
+        .def("save", &stream_container_t::save);
     class_<ac_encoder_t>(m, "ac_encoder_t")
         .def(init<>())
         .def(init<const int &>())
         .def_readwrite("bit_stream", &ac_encoder_t::bit_stream)
         .def("encode", &ac_encoder_t::encode)
         .def("encode_nx1", &ac_encoder_t::encode_nx1)
-        .def("encode_nxn", &ac_encoder_t::encode_nxn)
-        .def("flush", &ac_encoder_t::flush);
+        .def("encode_nxn", &ac_encoder_t::encode_nxn, arg("sym"), arg("cdf"), arg("cdf_bits"), arg("escape") = false)
+        .def("encode_group", &ac_encoder_t::encode_group)
+        .def("encode_param", &ac_encoder_t::encode_param)
+        .def("encode_adaptive", &ac_encoder_t::encode_adaptive)
+        .def("encode_context", &ac_encoder_t::encode_context)
+        .def("flush", &ac_encoder_t::flush)
+        .def("reset", &ac_encoder_t::reset)
+        .def("stats", &codec_stats<ac_encoder_t>)
+        .def("reset_stats", &ac_encoder_t::reset_stats);
     class_<ac_decoder_t>(m, "ac_decoder_t")
         .def(init<const bit_stream_t &>())
         .def(init<const int &, const bit_stream_t &>())
         .def_readwrite("bit_stream", &ac_decoder_t::bit_stream)
+        .def("reset", &ac_decoder_t::reset)
         .def("decode", &ac_decoder_t::decode)
         .def("decode_nx1", &ac_decoder_t::decode_nx1)
-        .def("decode_nxn", &ac_decoder_t::decode_nxn);
+        .def("decode_nxn", &ac_decoder_t::decode_nxn, arg("sym_cnt"), arg("cdf"), arg("cdf_bits"), arg("out"), arg("escape") = false)
+        .def("decode_group", &ac_decoder_t::decode_group)
+        .def("decode_param", &ac_decoder_t::decode_param)
+        .def("decode_adaptive", &ac_decoder_t::decode_adaptive)
+        .def("decode_context", &ac_decoder_t::decode_context)
+        .def("set_table_cache", &ac_decoder_t::set_table_cache)
+        .def("stats", &codec_stats<ac_decoder_t>)
+        .def("reset_stats", &ac_decoder_t::reset_stats);
+    class_<range_encoder_t>(m, "range_encoder_t")
+        .def(init<>())
+        .def(init<const int &>())
+        .def_readwrite("bit_stream", &range_encoder_t::bit_stream)
+        .def("encode", &range_encoder_t::encode)
+        .def("encode_nx1", &range_encoder_t::encode_nx1)
+        .def("encode_nxn", &range_encoder_t::encode_nxn, arg("sym"), arg("cdf"), arg("cdf_bits"), arg("escape") = false)
+        .def("encode_group", &range_encoder_t::encode_group)
+        .def("encode_param", &range_encoder_t::encode_param)
+        .def("encode_adaptive", &range_encoder_t::encode_adaptive)
+        .def("encode_context", &range_encoder_t::encode_context)
+        .def("encode_bit", &range_encoder_t::encode_bit)
+        .def("encode_bits", &range_encoder_t::encode_bits)
+        .def("encode_bits_adaptive", &range_encoder_t::encode_bits_adaptive)
+        .def("flush", &range_encoder_t::flush)
+        .def("reset", &range_encoder_t::reset)
+        .def("stats", &codec_stats<range_encoder_t>)
+        .def("reset_stats", &range_encoder_t::reset_stats);
+    class_<range_decoder_t>(m, "range_decoder_t")
+        .def(init<const bit_stream_t &>())
+        .def(init<const int &, const bit_stream_t &>())
+        .def_readwrite("bit_stream", &range_decoder_t::bit_stream)
+        .def("reset", &range_decoder_t::reset)
+        .def("decode", &range_decoder_t::decode)
+        .def("decode_nx1", &range_decoder_t::decode_nx1)
+        .def("decode_nxn", &range_decoder_t::decode_nxn, arg("sym_cnt"), arg("cdf"), arg("cdf_bits"), arg("out"), arg("escape") = false)
+        .def("decode_group", &range_decoder_t::decode_group)
+        .def("decode_param", &range_decoder_t::decode_param)
+        .def("decode_adaptive", &range_decoder_t::decode_adaptive)
+        .def("decode_context", &range_decoder_t::decode_context)
+        .def("decode_bit", &range_decoder_t::decode_bit)
+        .def("decode_bits", &range_decoder_t::decode_bits)
+        .def("decode_bits_adaptive", &range_decoder_t::decode_bits_adaptive)
+        .def("set_table_cache", &range_decoder_t::set_table_cache)
+        .def("stats", &codec_stats<range_decoder_t>)
+        .def("reset_stats", &range_decoder_t::reset_stats);
+    class_<tans_encoder_t>(m, "tans_encoder_t")
+        .def(init<>())
+        .def_readwrite("bit_stream", &tans_encoder_t::bit_stream)
+        .def("encode_nx1", &tans_encoder_t::encode_nx1)
+        .def("flush", &tans_encoder_t::flush)
+        .def("reset", &tans_encoder_t::reset)
+        .def("stats", &codec_stats<tans_encoder_t>)
+        .def("reset_stats", &tans_encoder_t::reset_stats);
+    class_<tans_decoder_t>(m, "tans_decoder_t")
+        .def(init<const bit_stream_t &>())
+        .def_readwrite("bit_stream", &tans_decoder_t::bit_stream)
+        .def("reset", &tans_decoder_t::reset)
+        .def("decode_nx1", &tans_decoder_t::decode_nx1)
+        .def("stats", &codec_stats<tans_decoder_t>)
+        .def("reset_stats", &tans_decoder_t::reset_stats);
+    class_<rans_snapshot_t>(m, "rans_snapshot_t")
+        .def_readonly("pos", &rans_snapshot_t::pos);
     class_<rans_codec_t>(m, "rans_codec_t")
         .def(init<>())
         .def(init<const int &, const int &>())
@@ -229,9 +1550,46 @@ PYBIND11_MODULE(yaecl, m) {
         .def_readwrite("bit_stream", &rans_codec_t::bit_stream)
         .def("encode", &rans_codec_t::encode)
         .def("encode_nx1", &rans_codec_t::encode_nx1)
-        .def("encode_nxn", &rans_codec_t::encode_nxn)
+        .def("encode_nxn", &rans_codec_t::encode_nxn, arg("sym"), arg("cdf"), arg("cdf_bits"), arg("escape") = false)
+        .def("encode_group", &rans_codec_t::encode_group)
+        .def("encode_nxn_indexed", &rans_codec_t::encode_nxn_indexed)
+        .def("encode_param", &rans_codec_t::encode_param)
         .def("flush", &rans_codec_t::flush)
+        .def("reset", static_cast<void (rans_codec_t::*)()>(&rans_codec_t::reset))
+        .def("reset", static_cast<void (rans_codec_t::*)(const bit_stream_t &)>(&rans_codec_t::reset))
         .def("decode", &rans_codec_t::decode)
         .def("decode_nx1", &rans_codec_t::decode_nx1)
-        .def("decode_nxn", &rans_codec_t::decode_nxn);
+        .def("decode_nxn", &rans_codec_t::decode_nxn, arg("sym_cnt"), arg("cdf"), arg("cdf_bits"), arg("out"), arg("escape") = false)
+        .def("decode_group", &rans_codec_t::decode_group)
+        .def("decode_nxn_indexed", &rans_codec_t::decode_nxn_indexed)
+        .def("decode_param", &rans_codec_t::decode_param)
+        .def("set_table_cache", &rans_codec_t::set_table_cache)
+        .def("snapshot", &rans_codec_t::snapshot)
+        .def("restore", &rans_codec_t::restore)
+        .def("release", &rans_codec_t::release)
+        .def("prefill", &rans_codec_t::prefill, arg("bytes"), arg("seed") = 0)
+        .def("info_bits", &rans_codec_t::info_bits)
+        .def("net_bits", &rans_codec_t::net_bits)
+        .def("reset_net_bits", &rans_codec_t::reset_net_bits)
+        .def("stats", &codec_stats<rans_codec_t>)
+        .def("reset_stats", &rans_codec_t::reset_stats);
+    m.def("encode_batch", &encode_batch<uint64_t, int>,
+          arg("codec"), arg("sym_list"), arg("cdf_list"), arg("cdf_bits"), arg("threads") = 0,
+          arg("precision") = 32, arg("h_precision") = 64, arg("t_precision") = 32);
+    m.def("decode_batch", &decode_batch<uint64_t, int>,
+          arg("codec"), arg("stream_list"), arg("sym_cnt"), arg("cdf_list"), arg("cdf_bits"), arg("out_list"), arg("threads") = 0,
+          arg("precision") = 32, arg("h_precision") = 64, arg("t_precision") = 32);
+    bind_interleaved_rans<rans_x2_codec_t>(m, "rans_x2_codec_t");
+    bind_interleaved_rans<rans_x4_codec_t>(m, "rans_x4_codec_t");
+    bind_interleaved_rans<rans_x8_codec_t>(m, "rans_x8_codec_t");
+    bind_interleaved_rans<rans_x16_codec_t>(m, "rans_x16_codec_t");
+    class_<chunked_codec_t>(m, "chunked_codec_t")
+        .def(init<const CodecType &, const int &, const int &>())
+        .def(init<const CodecType &, const int &, const int &, const int &, const int &, const int &>())
+        .def("encode_nx1", &chunked_codec_t::encode_nx1)
+        .def("encode_nxn", &chunked_codec_t::encode_nxn)
+        .def("decode_nx1", &chunked_codec_t::decode_nx1)
+        .def("decode_nxn", &chunked_codec_t::decode_nxn)
+        .def("stats", &codec_stats<chunked_codec_t>)
+        .def("reset_stats", &chunked_codec_t::reset_stats);
 }
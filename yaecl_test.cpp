@@ -1,3 +1,6 @@
+/* the checks of the tests are asserts, so they stay on in release builds (ctest) */
+#undef NDEBUG
+#include <sstream>
 #include <vector>
 #include "yaecl.hpp"
 using namespace std;
@@ -12,18 +15,74 @@ int main(){
         ace.encode(i % 5, cdf, 16);
     }
     ace.flush();
-    printf("[test] -- actual size: %d --- ideal info: %.2f\n", ace.bit_stream.size(), test_n * 2.3219);
+    printf("[test] -- actual size: %lld --- ideal info: %.2f\n", static_cast<long long>(ace.bit_stream.size()), test_n * 2.3219);
     ArithmeticCodingDecoder<uint64_t, uint32_t> acd = ArithmeticCodingDecoder<uint64_t, uint32_t>(32, ace.bit_stream);
     for(int i=1;i<=test_n;i++){
         assert(static_cast<int>(acd.decode(5, cdf, 16)) == i%5);
     }
     printf("[test] -- decode success\n");
+    printf("[test] testing streaming arithmetic coding\n");
+    ostringstream ac_out;
+    ArithmeticCodingEncoder<uint64_t, uint32_t> aces=ArithmeticCodingEncoder<uint64_t, uint32_t>(32);
+    aces.bit_stream.set_sink(BitStream::ostream_sink(ac_out), 64);
+    for(int i=1;i<=test_n;i++){
+        aces.encode(i % 5, cdf, 16);
+    }
+    aces.flush();
+    istringstream ac_in(ac_out.str());
+    BitStream ac_source;
+    ac_source.set_source(BitStream::istream_source(ac_in), 64);
+    ArithmeticCodingDecoder<uint64_t, uint32_t> acds = ArithmeticCodingDecoder<uint64_t, uint32_t>(32, std::move(ac_source));
+    for(int i=1;i<=test_n;i++){
+        assert(static_cast<int>(acds.decode(5, cdf, 16)) == i%5);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing adaptive arithmetic coding\n");
+    AdaptiveCDF<uint32_t> ac_model(5, 16);
+    ArithmeticCodingEncoder<uint64_t, uint32_t> acea=ArithmeticCodingEncoder<uint64_t, uint32_t>(32);
+    for(int i=1;i<=test_n;i++){
+        acea.encode((i % 5) * (i % 2), ac_model);
+    }
+    acea.flush();
+    printf("[test] -- actual size: %lld\n", static_cast<long long>(acea.bit_stream.size()));
+    ac_model.reset();
+    ArithmeticCodingDecoder<uint64_t, uint32_t> acda = ArithmeticCodingDecoder<uint64_t, uint32_t>(32, acea.bit_stream);
+    for(int i=1;i<=test_n;i++){
+        assert(static_cast<int>(acda.decode(ac_model)) == (i % 5) * (i % 2));
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing range coding\n");
+    RangeCodingEncoder<uint64_t, uint32_t> rce=RangeCodingEncoder<uint64_t, uint32_t>(32);
+    for(int i=1;i<=test_n;i++){
+        rce.encode(i % 5, cdf, 16);
+    }
+    rce.flush();
+    printf("[test] -- actual size: %lld --- ideal info: %.2f\n", static_cast<long long>(rce.bit_stream.size()), test_n * 2.3219);
+    RangeCodingDecoder<uint64_t, uint32_t> rcd = RangeCodingDecoder<uint64_t, uint32_t>(32, rce.bit_stream);
+    for(int i=1;i<=test_n;i++){
+        assert(static_cast<int>(rcd.decode(5, cdf, 16)) == i%5);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing range binary coding\n");
+    BitModel rc_model[2];
+    RangeCodingEncoder<uint64_t, uint32_t> rcb=RangeCodingEncoder<uint64_t, uint32_t>(32);
+    for(int i=1;i<=test_n;i++){
+        rcb.encode_bit(i % 5 == 0, rc_model[i % 2]);
+    }
+    rcb.flush();
+    printf("[test] -- actual size: %lld\n", static_cast<long long>(rcb.bit_stream.size()));
+    BitModel rd_model[2];
+    RangeCodingDecoder<uint64_t, uint32_t> rdb = RangeCodingDecoder<uint64_t, uint32_t>(32, rcb.bit_stream);
+    for(int i=1;i<=test_n;i++){
+        assert(rdb.decode_bit(rd_model[i % 2]) == int(i % 5 == 0));
+    }
+    printf("[test] -- decode success\n");
     printf("[test] testing rans interactive coding\n");
     RANSCodec<uint64_t, uint32_t> ranscd = RANSCodec<uint64_t, uint32_t>(64, 32);
     for(int i=1;i<=test_n;i++){
         ranscd.encode(i % 5, cdf, 16);
     }
-    printf("[test] -- actual size: %d --- ideal info: %.2f\n", ranscd.bit_stream.size(), test_n * 2.3219);
+    printf("[test] -- actual size: %lld --- ideal info: %.2f\n", static_cast<long long>(ranscd.bit_stream.size()), test_n * 2.3219);
     for(int i=test_n;i>=1;i--){
         assert(static_cast<int>(ranscd.decode(5, cdf, 16)) == i%5);
     }
@@ -34,9 +93,285 @@ int main(){
         ranse.encode(i % 5, cdf, 16);
     }
     ranse.flush();
-    printf("[test] -- actual size: %d --- ideal info: %.2f\n", ranse.bit_stream.size(), test_n * 2.3219);
+    printf("[test] -- actual size: %lld --- ideal info: %.2f\n", static_cast<long long>(ranse.bit_stream.size()), test_n * 2.3219);
     RANSCodec<uint64_t, uint32_t> ransd = RANSCodec<uint64_t, uint32_t>(64, 32, ranse.bit_stream);
     for(int i=test_n;i>=1;i--){
         assert(static_cast<int>(ransd.decode(5, cdf, 16)) == i%5);
     }
-}
\ No newline at end of file
+    printf("[test] -- decode success\n");
+    printf("[test] testing rans snapshot and restore\n");
+    RANSCodec<uint64_t, uint32_t> ransbb = RANSCodec<uint64_t, uint32_t>(64, 32);
+    ransbb.prefill(256);
+    RANSSnapshot<uint64_t> snap = ransbb.snapshot();
+    uint32_t popped = ransbb.decode(5, cdf, 16);
+    for(int i=1;i<=test_n;i++){
+        ransbb.encode(i % 5, cdf, 16);
+    }
+    printf("[test] -- net bits: %.2f\n", ransbb.net_bits());
+    ransbb.restore(snap);
+    ransbb.release();
+    assert(ransbb.decode(5, cdf, 16) == popped);
+    printf("[test] -- restore success\n");
+    printf("[test] testing rans with compile time precision\n");
+    RANSCodec<uint64_t, uint32_t, 64, 32> ransce;
+    for(int i=1;i<=test_n;i++){
+        ransce.encode<16>(i % 5, cdf);
+    }
+    ransce.flush();
+    assert(ransce.bit_stream.size() == ranse.bit_stream.size());
+    RANSCodec<uint64_t, uint32_t, 64, 32> ranscd2(ransce.bit_stream);
+    for(int i=test_n;i>=1;i--){
+        assert(static_cast<int>(ranscd2.decode<16>(5, cdf)) == i%5);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing rans decoding from a view\n");
+    vector<uint8_t> rans_bytes(ranse.bit_stream.data(), ranse.bit_stream.data() + ranse.bit_stream.byte_size());
+    RANSCodec<uint64_t, uint32_t> ransv = RANSCodec<uint64_t, uint32_t>(64, 32, BitStream::view(rans_bytes.data(), rans_bytes.size()));
+    for(int i=test_n;i>=1;i--){
+        assert(static_cast<int>(ransv.decode(5, cdf, 16)) == i%5);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing shared stream bytes\n");
+    ArithmeticCodingEncoder<uint64_t, uint32_t> ach(32);
+    for(int i=1;i<=test_n;i++){
+        ach.encode(i%5, cdf, 16);
+    }
+    assert(ach.bit_stream.share() && ach.bit_stream.is_view());
+    shared_ptr<const void> held = ach.bit_stream.owner();
+    const uint8_t *held_data = ach.bit_stream.data();
+    vector<uint8_t> held_copy(held_data, held_data + ach.bit_stream.byte_size());
+    for(int i=test_n+1;i<=2*test_n;i++){
+        ach.encode(i%5, cdf, 16);
+    }
+    ach.flush();
+    assert(!ach.bit_stream.is_view() && equal(held_copy.begin(), held_copy.end(), held_data));
+    ArithmeticCodingDecoder<uint64_t, uint32_t> achd(32, ach.bit_stream);
+    for(int i=1;i<=2*test_n;i++){
+        assert(static_cast<int>(achd.decode(5, cdf, 16)) == i%5);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing rans decoding from a mapped file\n");
+    ranse.bit_stream.save("yaecl_test_rans.bin");
+    RANSCodec<uint64_t, uint32_t> ransm = RANSCodec<uint64_t, uint32_t>(64, 32, BitStream::map("yaecl_test_rans.bin"));
+    for(int i=test_n;i>=1;i--){
+        assert(static_cast<int>(ransm.decode(5, cdf, 16)) == i%5);
+    }
+    remove("yaecl_test_rans.bin");
+    bool missing = false;
+    try{
+        BitStream::map("yaecl_test_rans.bin");
+    }catch(const std::runtime_error &){
+        missing = true;
+    }
+    assert(missing);
+    printf("[test] -- decode success\n");
+    printf("[test] testing rans table encoding\n");
+    RANSEncTable<uint64_t, uint32_t> rans_table = RANSEncTable<uint64_t, uint32_t>(5, cdf, 16, 64);
+    RANSCodec<uint64_t, uint32_t> ranste = RANSCodec<uint64_t, uint32_t>(64, 32);
+    for(int i=1;i<=test_n;i++){
+        ranste.encode(i % 5, rans_table);
+    }
+    ranste.flush();
+    assert(ranste.bit_stream.size() == ranse.bit_stream.size());
+    for(int64_t i=0;i<ranste.bit_stream.size();i++){
+        assert(ranste.bit_stream.get(i) == ranse.bit_stream.get(i));
+    }
+    printf("[test] -- bit exact with division\n");
+    printf("[test] testing interleaved rans coding\n");
+    vector<uint32_t> syms(test_n), symd(test_n);
+    for(int i=0;i<test_n;i++) syms[i] = i % 5;
+    InterleavedRANSCodec<uint64_t, uint32_t, 4> iranse = InterleavedRANSCodec<uint64_t, uint32_t, 4>(64, 32);
+    iranse.encode(syms[0], cdf, 16);
+    iranse.encode_n(syms.data() + 1, test_n - 1, cdf, 0, 16);
+    iranse.flush();
+    printf("[test] -- actual size: %lld --- ideal info: %.2f\n", static_cast<long long>(iranse.bit_stream.size()), test_n * 2.3219);
+    InterleavedRANSCodec<uint64_t, uint32_t, 4> iransd = InterleavedRANSCodec<uint64_t, uint32_t, 4>(64, 32, iranse.bit_stream);
+    iransd.decode_n(symd.data(), test_n, 5, cdf, 0, 16);
+    for(int i=0;i<test_n;i++){
+        assert(symd[i] == syms[test_n - 1 - i]);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing scalar and simd kernels\n");
+    const SimdLevel best = simd_level();
+    set_simd_level(SimdLevel::SCALAR);
+    InterleavedRANSCodec<uint64_t, uint32_t, 4> iranss = InterleavedRANSCodec<uint64_t, uint32_t, 4>(64, 32, iranse.bit_stream);
+    vector<uint32_t> symd_scalar(test_n);
+    iranss.decode_n(symd_scalar.data(), test_n, 5, cdf, 0, 16);
+    assert(symd_scalar == symd);
+    for(uint32_t v=0;v<cdf_max;v+=97){
+        uint32_t sym = cdf_search(5, cdf, v);
+        set_simd_level(best);
+        assert(cdf_search(5, cdf, v) == sym && cdf[sym] <= v && v < cdf[sym + 1]);
+        set_simd_level(SimdLevel::SCALAR);
+    }
+    set_simd_level(best);
+    printf("[test] -- %d matches scalar\n", static_cast<int>(best));
+    printf("[test] testing tans coding\n");
+    vector<uint32_t> tans_sym(test_n), tans_out(test_n);
+    for(int i=0;i<test_n;i++) tans_sym[i] = i % 5;
+    TANSEncoder<uint32_t> tanse;
+    tanse.encode_nx1(tans_sym.data(), test_n, 5, cdf, 16);
+    printf("[test] -- actual size: %lld --- ideal info: %.2f\n", static_cast<long long>(tanse.bit_stream.size()), test_n * 2.3219);
+    TANSDecoder<uint32_t> tansd(tanse.bit_stream);
+    tansd.decode_nx1(tans_out.data(), test_n, 5, cdf, 16);
+    assert(tans_out == tans_sym);
+    uint32_t tans_cdf[6] = {0, 1, 3, 1 << 12, (1 << 20) - 5, 1 << 20};
+    TANSEncoder<uint32_t> tanse20;
+    tanse20.encode_nx1(tans_sym.data(), test_n, 5, tans_cdf, 20);
+    TANSDecoder<uint32_t> tansd20(tanse20.bit_stream);
+    tansd20.decode_nx1(tans_out.data(), test_n, 5, tans_cdf, 20);
+    assert(tans_out == tans_sym);
+    printf("[test] -- decode success\n");
+    printf("[test] testing chunked coding\n");
+    CodecType chunk_codecs[3] = {CodecType::AC, CodecType::RANGE, CodecType::RANS};
+    for(int c=0;c<3;c++){
+        ChunkedCodec<uint64_t, uint32_t> chunked = ChunkedCodec<uint64_t, uint32_t>(CodecParams(chunk_codecs[c]), 7, 4);
+        BitStream chunked_stream = chunked.encode(syms.data(), test_n, cdf, 0, 16);
+        printf("[test] -- codec %d actual size: %lld\n", c, static_cast<long long>(chunked_stream.size()));
+        fill(symd.begin(), symd.end(), 0);
+        chunked.decode(chunked_stream, symd.data(), test_n, 5, cdf, 0, 16);
+        for(int i=0;i<test_n;i++){
+            assert(symd[i] == syms[i]);
+        }
+        bool rejected = false;
+        BitStream truncated = BitStream::view(chunked_stream.data(), chunked_stream.byte_size() - 1);
+        try{
+            chunked.decode(truncated, symd.data(), test_n, 5, cdf, 0, 16);
+        }catch(const std::runtime_error &){
+            rejected = true;
+        }
+        assert(rejected);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing parametric gaussian coding\n");
+    ParametricCDFBank<uint32_t> bank = ParametricCDFBank<uint32_t>(Distribution::GAUSSIAN, ParametricCDFBank<uint32_t>::default_scale_table(), 16);
+    vector<float> values(test_n), means(test_n), scales(test_n), valued(test_n);
+    for(int i=0;i<test_n;i++){
+        means[i] = 0.1f * (i % 7);
+        scales[i] = 1.5f + (i % 11);
+        values[i] = means[i] + static_cast<float>(i % 5) - 2.0f;
+    }
+    values[1] = means[1] + 30000.0f;
+    values[2] = means[2] - 30000.0f;
+    ArithmeticCodingEncoder<uint64_t, uint32_t> acpe = ArithmeticCodingEncoder<uint64_t, uint32_t>(32);
+    encode_param(acpe, bank, values.data(), means.data(), scales.data(), test_n);
+    acpe.flush();
+    printf("[test] -- actual size: %lld\n", static_cast<long long>(acpe.bit_stream.size()));
+    ArithmeticCodingDecoder<uint64_t, uint32_t> acpd = ArithmeticCodingDecoder<uint64_t, uint32_t>(32, acpe.bit_stream);
+    decode_param(acpd, bank, means.data(), scales.data(), valued.data(), test_n);
+    for(int i=0;i<test_n;i++){
+        assert(fabs(valued[i] - values[i]) < 1e-4);
+    }
+    printf("[test] -- decode success\n");
+    printf("[test] testing codec reuse\n");
+    const int64_t ac_size = ace.bit_stream.size();
+    const size_t ac_capacity = ace.bit_stream.capacity();
+    ace.reset();
+    for(int i=1;i<=test_n;i++){
+        ace.encode(i % 5, cdf, 16);
+    }
+    ace.flush();
+    assert(ace.bit_stream.size() == ac_size && ace.bit_stream.capacity() == ac_capacity);
+    acd.reset(ace.bit_stream);
+    for(int i=1;i<=test_n;i++){
+        assert(static_cast<int>(acd.decode(5, cdf, 16)) == i%5);
+    }
+    BitStreamPool pool(1 << 10, 4);
+    BitStream pooled = pool.acquire();
+    pooled.push_back_bytes(iranse.bit_stream.data(), iranse.bit_stream.byte_size());
+    const size_t pooled_capacity = pooled.capacity();
+    pool.release(pooled);
+    assert(pooled.size() == 0 && pool.free_count() == 1);
+    BitStream reused = pool.acquire();
+    assert(reused.size() == 0 && reused.capacity() == pooled_capacity && pool.free_count() == 0);
+    printf("[test] -- reuse success\n");
+    printf("[test] testing stream container\n");
+    StreamContainer container;
+    container.add("z", ace.bit_stream, CodecParams(CodecType::AC), 16, test_n);
+    container.add("y", ranse.bit_stream, CodecParams(CodecType::RANS), 16, test_n);
+    container.save("yaecl_test_container.bin");
+    StreamContainer opened = StreamContainer::open("yaecl_test_container.bin");
+    assert(opened.size() == 2 && opened.find("y") == 1 && opened.find("x") == -1);
+    const SubstreamInfo &y_info = opened.info(opened.find("y"));
+    assert(y_info.codec == CodecType::RANS && y_info.cdf_bits == 16 && y_info.sym_count == static_cast<uint64_t>(test_n));
+    RANSCodec<uint64_t, uint32_t> ransc = RANSCodec<uint64_t, uint32_t>(y_info.h_precision, y_info.t_precision, opened.substream(1));
+    for(int i=test_n;i>=1;i--){
+        assert(static_cast<int>(ransc.decode(5, cdf, y_info.cdf_bits)) == i%5);
+    }
+    remove("yaecl_test_container.bin");
+    BitStream written = container.write();
+    bool corrupt = false;
+    try{
+        StreamContainer truncated(BitStream::view(written.data(), 40));
+    }catch(const std::runtime_error &){
+        corrupt = true;
+    }
+    assert(corrupt);
+    printf("[test] -- decode success\n");
+    printf("[test] testing context model coding\n");
+    /* the next symbol is likely the previous one plus one */
+    vector<uint32_t> ctx_cdf(5 * 6);
+    for(int prev=0;prev<5;prev++){
+        for(int j=0;j<=5;j++)
+            ctx_cdf[prev * 6 + j] = j * 4096 + (j > (prev + 1) % 5 ? cdf_max - 5 * 4096 : 0);
+    }
+    auto ctx_model = [&ctx_cdf](int64_t i, const uint32_t *prev_sym){
+        return ctx_cdf.data() + (i == 0 ? 0 : prev_sym[i - 1]) * 6;
+    };
+    RANSCodec<uint64_t, uint32_t> ctxe;
+    encode_with_model(ctxe, syms.data(), test_n, 5, 16, ctx_model);
+    ctxe.flush();
+    printf("[test] -- actual size: %lld\n", static_cast<long long>(ctxe.bit_stream.size()));
+    RANSCodec<uint64_t, uint32_t> ctxd(ctxe.bit_stream);
+    vector<uint32_t> ctx_out(test_n);
+    decode_with_model(ctxd, ctx_out.data(), test_n, 5, 16, ctx_model);
+    assert(ctx_out == syms);
+    printf("[test] -- decode success\n");
+    printf("[test] testing codec stats\n");
+    RangeCodingEncoder<uint64_t, uint32_t> statse;
+    for(int i=1;i<=test_n;i++){
+        statse.encode(i % 5, cdf, 16);
+    }
+    statse.flush();
+    const CodecStats &stats = statse.stats();
+    if(CodecStats::enabled()){
+        assert(stats.symbols == test_n && stats.renorm >= statse.bit_stream.size() / 8);
+        assert(stats.overhead(statse.bit_stream.size()) >= 0 && stats.overhead(statse.bit_stream.size()) < 64);
+    }else{
+        assert(stats.symbols == 0 && stats.ideal_bits == 0);
+    }
+    printf("[test] -- stats success\n");
+    printf("[test] testing escape coding\n");
+    vector<int32_t> esc_syms(test_n);
+    for(int i=0;i<test_n;i++){
+        esc_syms[i] = i % 7 == 0 ? (i % 2 ? -i : i * 13) : i % 4;
+    }
+    ArithmeticCodingEncoder<uint64_t, uint32_t> esce(32);
+    for(int i=0;i<test_n;i++){
+        encode_escape(esce, esc_syms[i], 5, cdf, 16);
+    }
+    esce.flush();
+    printf("[test] -- actual size: %lld\n", static_cast<long long>(esce.bit_stream.size()));
+    ArithmeticCodingDecoder<uint64_t, uint32_t> escd(32, esce.bit_stream);
+    for(int i=0;i<test_n;i++){
+        int32_t sym = read_escape(escd, static_cast<int32_t>(escd.decode(5, cdf, 16)), 5);
+        assert(sym == esc_syms[i]);
+    }
+    /* 2 bypass bits at precision 28 of a 32 bit coder, 2 ** 62 takes 63 + 31 pieces */
+    uint32_t bin_cdf[3] = {0, 1, 2};
+    ArithmeticCodingEncoder<uint32_t, uint32_t> esc28e(28);
+    assert(esc28e.bypass_bits() == 2);
+    encode_escape(esc28e, static_cast<int64_t>(1) << 62, 2, bin_cdf, 1);
+    esc28e.flush();
+    ArithmeticCodingDecoder<uint32_t, uint32_t> esc28d(28, esc28e.bit_stream);
+    assert(read_escape(esc28d, static_cast<int64_t>(esc28d.decode(2, bin_cdf, 1)), 2) == static_cast<int64_t>(1) << 62);
+    bool no_bypass = false;
+    ArithmeticCodingEncoder<uint32_t, uint32_t> esc30e(30);
+    try{
+        encode_escape(esc30e, static_cast<int64_t>(7), 2, bin_cdf, 1);
+    }catch(const std::invalid_argument &){
+        no_bypass = true;
+    }
+    assert(no_bypass);
+    printf("[test] -- decode success\n");
+}
@@ -1,3 +1,4 @@
+import io
 import numpy as np
 import yaecl
 from timeit import default_timer as timer
@@ -49,6 +50,23 @@ def test_ac_nxn():
     print("ac batch decoding elapse: {0:.4f} s".format(end - start))
     assert(np.sum(np.abs(sym_b - symd_b)) == 0)
 
+def test_range_nxn():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    cdf_b = np.array([cdf for _ in range(cnt)], dtype=np.int32)
+    symd_b = np.array([0 for _ in range(cnt)], dtype=np.int32)
+    range_enc = yaecl.range_encoder_t()
+    start = timer()
+    range_enc.encode_nxn(sym_b, cdf_b, 16)
+    range_enc.flush()
+    end = timer()
+    print("range batch encoding elapse: {0:.4f} s".format(end - start))
+    range_dec = yaecl.range_decoder_t(range_enc.bit_stream)
+    start = timer()
+    range_dec.decode_nxn(5, memoryview(cdf_b), 16, memoryview(symd_b))
+    end = timer()
+    print("range batch decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.sum(np.abs(sym_b - symd_b)) == 0)
+
 def test_rans_1x1():
     rans_enc = yaecl.rans_codec_t()
     start = timer()
@@ -82,6 +100,309 @@ def test_rans_nxn():
     print("rans batch decoding elapse: {0:.4f} s".format(end - start))
     assert(np.sum(np.abs(sym_b - np.flip(symd_b)) == 0))
 
+def test_rans_nxn_table_cache():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    cdf_b = np.array([cdf for _ in range(cnt)], dtype=np.int32)
+    symd_b = np.array([0 for _ in range(cnt)], dtype=np.int32)
+    rans_enc = yaecl.rans_codec_t()
+    rans_enc.encode_nxn(sym_b, cdf_b, 16)
+    rans_enc.flush()
+    rans_dec = yaecl.rans_codec_t(rans_enc.bit_stream)
+    rans_dec.set_table_cache(16)
+    start = timer()
+    rans_dec.decode_nxn(5, memoryview(cdf_b), 16, memoryview(symd_b))
+    end = timer()
+    print("rans batch decoding with table cache elapse: {0:.4f} s".format(end - start))
+    assert(np.sum(np.abs(sym_b - np.flip(symd_b))) == 0)
+
+def test_rans_nxn_indexed():
+    cdf_bank = np.array([cdf, [0, 2 ** 15, 2 ** 15 + 2 ** 14, 2 ** 16 - 2, 2 ** 16 - 1, 2 ** 16]], dtype=np.int32)
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    idx_b = np.array([(i // 7) % 2 for i in range(cnt)], dtype=np.int32)
+    symd_b = np.array([0 for _ in range(cnt)], dtype=np.int32)
+    rans_enc = yaecl.rans_codec_t()
+    start = timer()
+    rans_enc.encode_nxn_indexed(sym_b, idx_b, cdf_bank, 16)
+    rans_enc.flush()
+    end = timer()
+    print("rans indexed encoding elapse: {0:.4f} s".format(end - start))
+    rans_dec = yaecl.rans_codec_t(rans_enc.bit_stream)
+    start = timer()
+    rans_dec.decode_nxn_indexed(np.flip(idx_b).astype(np.int64), cdf_bank, 16, memoryview(symd_b))
+    end = timer()
+    print("rans indexed decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.sum(np.abs(sym_b - np.flip(symd_b))) == 0)
+    try:
+        rans_enc.encode_nxn_indexed(sym_b[:1], np.array([2]), cdf_bank, 16)
+        assert(False)
+    except IndexError:
+        pass
+
+def test_rans_x4_nxn():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    cdf_b = np.array([cdf for _ in range(cnt)], dtype=np.int32)
+    symd_b = np.array([0 for _ in range(cnt)], dtype=np.int32)
+    rans_enc = yaecl.rans_x4_codec_t()
+    start = timer()
+    rans_enc.encode_nxn(sym_b, cdf_b, 16)
+    rans_enc.flush()
+    end = timer()
+    print("rans x4 batch encoding elapse: {0:.4f} s".format(end - start))
+    rans_dec = yaecl.rans_x4_codec_t(rans_enc.bit_stream)
+    start = timer()
+    rans_dec.decode_nxn(5, memoryview(cdf_b), 16, memoryview(symd_b))
+    end = timer()
+    print("rans x4 batch decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.sum(np.abs(sym_b - np.flip(symd_b))) == 0)
+    best = yaecl.simd_level()
+    yaecl.set_simd_level(yaecl.simd_level_t.SCALAR)
+    rans_dec = yaecl.rans_x4_codec_t(rans_enc.bit_stream)
+    symd_scalar = np.zeros(cnt, dtype=np.int32)
+    start = timer()
+    rans_dec.decode_nxn(5, memoryview(cdf_b), 16, memoryview(symd_scalar))
+    end = timer()
+    yaecl.set_simd_level(best)
+    print("rans x4 scalar decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.all(symd_scalar == symd_b))
+
+def test_chunked_nxn():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    cdf_b = np.array([cdf for _ in range(cnt)], dtype=np.int32)
+    for codec in [yaecl.codec_type_t.AC, yaecl.codec_type_t.RANGE, yaecl.codec_type_t.RANS]:
+        symd_b = np.array([0 for _ in range(cnt)], dtype=np.int32)
+        chunked = yaecl.chunked_codec_t(codec, 8, 0)
+        start = timer()
+        bit_stream = chunked.encode_nxn(sym_b, cdf_b, 16)
+        end = timer()
+        print("{0} chunked encoding elapse: {1:.4f} s".format(codec, end - start))
+        start = timer()
+        chunked.decode_nxn(bit_stream, 5, memoryview(cdf_b), 16, memoryview(symd_b))
+        end = timer()
+        print("{0} chunked decoding elapse: {1:.4f} s".format(codec, end - start))
+        assert(np.sum(np.abs(sym_b - symd_b)) == 0)
+
+def test_batch_nxn():
+    sym_list = [np.array([(i + j) % 5 for i in range(cnt // 8)], dtype=np.int32) for j in range(8)]
+    cdf_list = [np.array([cdf for _ in range(cnt // 8)], dtype=np.int32) for _ in range(8)]
+    out_list = [np.zeros(cnt // 8, dtype=np.int32) for _ in range(8)]
+    start = timer()
+    streams = yaecl.encode_batch(yaecl.codec_type_t.RANS, sym_list, cdf_list, 16)
+    end = timer()
+    print("rans batch of 8 encoding elapse: {0:.4f} s".format(end - start))
+    start = timer()
+    yaecl.decode_batch(yaecl.codec_type_t.RANS, streams, 5, cdf_list, 16, out_list)
+    end = timer()
+    print("rans batch of 8 decoding elapse: {0:.4f} s".format(end - start))
+    for sym_b, symd_b in zip(sym_list, out_list):
+        assert(np.sum(np.abs(sym_b - symd_b)) == 0)
+
+def test_bit_stream_view():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    symd_b = np.array([0 for _ in range(cnt)], dtype=np.int32)
+    ac_enc = yaecl.ac_encoder_t()
+    ac_enc.encode_nx1(sym_b, memoryview(cdf), 16)
+    ac_enc.flush()
+    data = np.frombuffer(ac_enc.bit_stream, dtype=np.uint8)
+    assert(data.tobytes() == ac_enc.bit_stream.data)
+    assert(np.shares_memory(data, np.frombuffer(ac_enc.bit_stream, dtype=np.uint8)))
+    saved = ac_enc.bit_stream.data
+    ac_enc.bit_stream.clear()
+    ac_enc.bit_stream.reserve(1 << 20)
+    assert(data.tobytes() == saved)
+    ac_enc.bit_stream.data = saved
+    ac_dec = yaecl.ac_decoder_t(yaecl.bit_stream_t(ac_enc.bit_stream.data))
+    ac_dec.decode_nx1(5, memoryview(cdf), 16, memoryview(symd_b))
+    assert(np.sum(np.abs(sym_b - symd_b)) == 0)
+    ac_enc.bit_stream.save("yaecl_test_ac.bin")
+    ac_dec = yaecl.ac_decoder_t(yaecl.bit_stream_t.map("yaecl_test_ac.bin"))
+    ac_dec.decode_nx1(5, memoryview(cdf), 16, memoryview(symd_b))
+    assert(np.sum(np.abs(sym_b - symd_b)) == 0)
+
+def test_ac_streaming():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    symd_b = np.array([0 for _ in range(cnt)], dtype=np.int32)
+    out = io.BytesIO()
+    ac_enc = yaecl.ac_encoder_t()
+    ac_enc.bit_stream.set_sink(out.write, 4096)
+    ac_enc.encode_nx1(sym_b, memoryview(cdf), 16)
+    ac_enc.flush()
+    src = yaecl.bit_stream_t()
+    src.set_source(io.BytesIO(out.getvalue()).read, 4096)
+    ac_dec = yaecl.ac_decoder_t(src)
+    ac_dec.decode_nx1(5, memoryview(cdf), 16, memoryview(symd_b))
+    assert(np.sum(np.abs(sym_b - symd_b)) == 0)
+
+def test_ac_param():
+    rng = np.random.default_rng(0)
+    means = rng.normal(0, 10, cnt).astype(np.float32)
+    scales = np.exp(rng.normal(0, 1, cnt)).astype(np.float32)
+    values = means + np.round(rng.normal(0, 1, cnt) * scales).astype(np.float32)
+    values[:2] = means[:2] + np.array([10000, -10000], dtype=np.float32)
+    valued = np.zeros(cnt, dtype=np.float32)
+    bank = yaecl.param_cdf_bank_t(yaecl.distribution_t.GAUSSIAN)
+    ac_enc = yaecl.ac_encoder_t()
+    start = timer()
+    ac_enc.encode_param(values, means, scales, bank)
+    ac_enc.flush()
+    end = timer()
+    print("ac gaussian encoding elapse: {0:.4f} s".format(end - start))
+    ac_dec = yaecl.ac_decoder_t(ac_enc.bit_stream)
+    start = timer()
+    ac_dec.decode_param(means, scales, bank, memoryview(valued))
+    end = timer()
+    print("ac gaussian decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.max(np.abs(values - valued)) < 1e-3)
+
+def test_ac_adaptive():
+    rng = np.random.default_rng(0)
+    ctx = (np.arange(cnt) % 3).astype(np.int32)
+    sym = np.minimum(rng.geometric(0.3 + 0.2 * ctx) - 1, 15).astype(np.int32)
+    symd = np.zeros(cnt, dtype=np.int32)
+    models = [yaecl.adaptive_cdf_t(16) for _ in range(3)]
+    ac_enc = yaecl.ac_encoder_t()
+    start = timer()
+    ac_enc.encode_context(sym, ctx, models)
+    ac_enc.flush()
+    end = timer()
+    print("ac adaptive encoding elapse: {0:.4f} s".format(end - start))
+    for model in models:
+        model.reset()
+    ac_dec = yaecl.ac_decoder_t(ac_enc.bit_stream)
+    start = timer()
+    ac_dec.decode_context(ctx, models, memoryview(symd))
+    end = timer()
+    print("ac adaptive decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.all(sym == symd))
+
+def test_range_bits():
+    rng = np.random.default_rng(0)
+    ctx = (np.arange(cnt) % 4).astype(np.int32)
+    bits = (rng.random(cnt) < 0.05 + 0.2 * ctx).astype(np.uint8)
+    bitsd = np.zeros(cnt, dtype=np.uint8)
+    range_enc = yaecl.range_encoder_t()
+    start = timer()
+    range_enc.encode_bits_adaptive(bits, ctx, yaecl.bit_models_t(4))
+    range_enc.flush()
+    end = timer()
+    print("range adaptive bit encoding elapse: {0:.4f} s".format(end - start))
+    range_dec = yaecl.range_decoder_t(range_enc.bit_stream)
+    start = timer()
+    range_dec.decode_bits_adaptive(ctx, yaecl.bit_models_t(4), memoryview(bitsd))
+    end = timer()
+    print("range adaptive bit decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.all(bits == bitsd))
+
+def test_rans_snapshot():
+    rans_codec = yaecl.rans_codec_t()
+    rans_codec.prefill(64)
+    assert(rans_codec.net_bits() == 0)
+    snap = rans_codec.snapshot()
+    sym_a = np.array([rans_codec.decode(5, memoryview(cdf), 16) for _ in range(100)], dtype=np.int32)
+    rans_codec.encode_nx1(sym_a[::-1].copy(), memoryview(cdf), 16)
+    rans_codec.restore(snap)
+    sym_b = np.array([rans_codec.decode(5, memoryview(cdf), 16) for _ in range(100)], dtype=np.int32)
+    assert(np.all(sym_a == sym_b))
+    rans_codec.release()
+    assert(rans_codec.net_bits() < -200)
+
+def test_tans_nx1():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    symd_b = np.zeros(cnt, dtype=np.int32)
+    tans_enc = yaecl.tans_encoder_t()
+    start = timer()
+    tans_enc.encode_nx1(memoryview(sym_b), memoryview(cdf), 16)
+    tans_enc.flush()
+    end = timer()
+    print("tans nx1 encoding elapse: {0:.4f} s".format(end - start))
+    tans_dec = yaecl.tans_decoder_t(tans_enc.bit_stream)
+    start = timer()
+    tans_dec.decode_nx1(5, memoryview(cdf), 16, memoryview(symd_b))
+    end = timer()
+    print("tans nx1 decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.all(sym_b == symd_b))
+
+def test_ac_nd():
+    sym_b = np.array([i % 5 for i in range(cnt)], dtype=np.int16).reshape(4, 3, -1, 32).transpose(0, 1, 3, 2)
+    cdf_c = np.array([cdf, [0, 6553, 19660, 32768, 52428, cdf_max], cdf], dtype=np.int32).reshape(3, 1, 1, 6)
+    symd_b = np.zeros(sym_b.shape, dtype=np.uint8)
+    ac_enc = yaecl.ac_encoder_t()
+    start = timer()
+    ac_enc.encode_nxn(sym_b, cdf_c, 16)
+    ac_enc.flush()
+    end = timer()
+    print("ac strided int16 encoding elapse: {0:.4f} s".format(end - start))
+    ac_dec = yaecl.ac_decoder_t(ac_enc.bit_stream)
+    start = timer()
+    ac_dec.decode_nxn(5, cdf_c, 16, symd_b)
+    end = timer()
+    print("ac strided uint8 decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.all(symd_b == sym_b))
+
+def test_stream_container():
+    sym_z = np.array([i % 5 for i in range(cnt // 16)], dtype=np.int32)
+    sym_y = np.array([(i * 3) % 5 for i in range(cnt)], dtype=np.int32)
+    ac_enc = yaecl.ac_encoder_t()
+    ac_enc.encode_nx1(sym_z, memoryview(cdf), 16)
+    ac_enc.flush()
+    rans_enc = yaecl.rans_codec_t()
+    rans_enc.encode_nx1(sym_y[::-1].copy(), memoryview(cdf), 16)
+    rans_enc.flush()
+    container = yaecl.stream_container_t()
+    container.add("z", ac_enc.bit_stream, yaecl.codec_type_t.AC, 16, sym_count=len(sym_z))
+    container.add("y", rans_enc.bit_stream, yaecl.codec_type_t.RANS, 16, sym_count=len(sym_y))
+    container.save("yaecl_test_container.bin")
+    start = timer()
+    opened = yaecl.stream_container_t.open("yaecl_test_container.bin")
+    k = opened.find("y")
+    info = opened.info(k)
+    rans_dec = yaecl.rans_codec_t(info.h_precision, info.t_precision, opened.substream(k))
+    symd_y = np.zeros(info.sym_count, dtype=np.int32)
+    rans_dec.decode_nx1(5, memoryview(cdf), info.cdf_bits, symd_y)
+    end = timer()
+    print("container seek and decoding elapse: {0:.4f} s".format(end - start))
+    assert(info.codec == yaecl.codec_type_t.RANS and np.all(symd_y == sym_y))
+
+def test_ac_group():
+    h, w = 64, cnt // 64
+    sym = np.array([(i * 7 + i // w) % 5 for i in range(h * w)], dtype=np.int32).reshape(h, w)
+    color = (np.arange(h)[:, None] + np.arange(w)[None, :]) % 2
+    pos = [np.flatnonzero(color == c) for c in range(2)]
+    # the cdf of the second color is picked by the left / right neighbour, from the first color
+    cdf_bank = np.array([np.roll(np.diff(cdf), k) for k in range(5)], dtype=np.int32)
+    cdf_bank = np.concatenate([np.zeros((5, 1), dtype=np.int32), np.cumsum(cdf_bank, axis=1, dtype=np.int32)], axis=1)
+    def group_cdf(c, plane):
+        if c == 0:
+            return np.array(cdf, dtype=np.int32)
+        neighbour = pos[1] - 1 + 2 * (pos[1] % w == 0)
+        return cdf_bank[plane.reshape(-1)[neighbour]]
+    ac_enc = yaecl.ac_encoder_t()
+    for c in range(2):
+        ac_enc.encode_group(sym, pos[c], group_cdf(c, sym), 16)
+    ac_enc.flush()
+    symd = np.zeros((h, w), dtype=np.int32)
+    ac_dec = yaecl.ac_decoder_t(ac_enc.bit_stream)
+    start = timer()
+    for c in range(2):
+        ac_dec.decode_group(5, pos[c], group_cdf(c, symd), 16, symd)
+    end = timer()
+    print("ac checkerboard group decoding elapse: {0:.4f} s".format(end - start))
+    assert(np.all(symd == sym))
+
+def test_range_stats():
+    sym = np.array([i % 5 for i in range(cnt)], dtype=np.int32)
+    range_enc = yaecl.range_encoder_t()
+    start = timer()
+    range_enc.encode_nx1(sym, memoryview(cdf), 16)
+    range_enc.flush()
+    end = timer()
+    print("range encoding with stats elapse: {0:.4f} s".format(end - start))
+    stats = range_enc.stats()
+    if yaecl.stats_enabled():
+        assert(stats["symbols"] == cnt and stats["renorm"] > 0)
+        print("range overhead: {0:.1f} bits".format(range_enc.bit_stream.size() - stats["ideal_bits"]))
+    else:
+        assert(stats["symbols"] == 0)
+
 def test_rans_1x1_interactive():
     rans_codec = yaecl.rans_codec_t()
     start = timer()
@@ -95,10 +416,52 @@ def test_rans_1x1_interactive():
         assert(de_sym == i % 5)
     end = timer()
     print("rans naive decoding elapse: {0:.4f} s".format(end - start))
+def test_rans_escape():
+    # laplacian-like latent, the last bin of cdf is the escape bin for the tails and negative values
+    rng = np.random.default_rng(0)
+    sym = np.round(rng.laplace(1.5, 3.0, size=(16, cnt // 16))).astype(np.int32)
+    sym[0, :4] = [np.iinfo(np.int32).max, np.iinfo(np.int32).min, 4, -1]
+    rans_enc = yaecl.rans_codec_t()
+    start = timer()
+    rans_enc.encode_nxn(sym, memoryview(cdf), 16, escape=True)
+    rans_enc.flush()
+    end = timer()
+    print("rans escape encoding elapse: {0:.4f} s".format(end - start))
+    symd = np.zeros_like(sym)
+    rans_dec = yaecl.rans_codec_t(rans_enc.bit_stream)
+    rans_dec.decode_nxn(5, memoryview(cdf), 16, symd, escape=True)
+    assert(np.all(symd.reshape(-1)[::-1] == sym.reshape(-1)))
+    # int64 symbols are escaped with their full value
+    wide = np.array([2 ** 32 + 1, -2 ** 40, 3, 2 ** 62], dtype=np.int64)
+    ac_enc = yaecl.ac_encoder_t()
+    ac_enc.encode_nxn(wide, memoryview(cdf), 16, escape=True)
+    ac_enc.flush()
+    wided = np.zeros_like(wide)
+    ac_dec = yaecl.ac_decoder_t(ac_enc.bit_stream)
+    ac_dec.decode_nxn(5, memoryview(cdf), 16, wided, escape=True)
+    assert(np.all(wided == wide))
 
 test_ac_1x1()
 test_ac_nx1()
 test_ac_nxn()
+test_range_nxn()
 test_rans_1x1()
 test_rans_1x1_interactive()
-test_rans_nxn()
\ No newline at end of file
+test_rans_nxn()
+test_rans_nxn_table_cache()
+test_rans_nxn_indexed()
+test_rans_x4_nxn()
+test_chunked_nxn()
+test_batch_nxn()
+test_bit_stream_view()
+test_ac_streaming()
+test_ac_param()
+test_ac_adaptive()
+test_range_bits()
+test_rans_snapshot()
+test_tans_nx1()
+test_ac_nd()
+test_stream_container()
+test_ac_group()
+test_range_stats()
+test_rans_escape()